@@ -0,0 +1,118 @@
+#include "bit_reader.h"
+#include "block_splitter.h"
+#include "decode_table.h"
+#include "huffman.h"
+#include "transforms.h"
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <iterator>
+
+using namespace huffman;
+
+static std::string read_file(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        throw std::invalid_argument("no file");
+    return std::string((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+}
+
+static void report(const std::string& name, std::size_t bytes, const std::function<void()>& run) {
+    const std::size_t repeats = 5;
+    double best = 0;
+    for (std::size_t i = 0; i < repeats; ++i) {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        run();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        if (i == 0 || seconds < best)
+            best = seconds;
+    }
+    std::cout << name << ": " << bytes / best / 1e6 << " MB/s" << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    std::string text = read_file(argc > 1 ? argv[1] : "samples/vim.txt");
+    std::map<char, std::size_t> table = huffman_encoder::get_table(text);
+    huffman_tree tree(table);
+    std::map<char, std::string> symbol_to_code = tree.get_symbol_to_code();
+    std::vector<std::size_t> index;
+    std::string bits = huffman_encoder::get_encoded_text(text, symbol_to_code, index, 0), payload;
+    for (std::size_t i = 0; i < bits.size(); i += BYTE_SIZE)
+        payload += (char)std::stoi(bits.substr(i, BYTE_SIZE), nullptr, 2);
+    volatile std::uint64_t sink = 0;
+
+    for (std::size_t width : {1, 8, 11, 24}) {
+        report("bit_reader msb read(" + std::to_string(width) + ")", payload.size(), [&]() {
+            bit_reader<> reader(payload);
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < payload.size() * BYTE_SIZE / width; ++i)
+                sum += reader.read(width);
+            sink = sum;
+        });
+        report("bit_reader lsb read(" + std::to_string(width) + ")", payload.size(), [&]() {
+            bit_reader<bit_order::lsb_first> reader(payload);
+            std::uint64_t sum = 0;
+            for (std::size_t i = 0; i < payload.size() * BYTE_SIZE / width; ++i)
+                sum += reader.read(width);
+            sink = sum;
+        });
+    }
+    report("bit_reader msb read_bit", payload.size(), [&]() {
+        bit_reader<> reader(payload);
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < payload.size() * BYTE_SIZE; ++i)
+            sum += reader.read_bit();
+        sink = sum;
+    });
+    report("bit_reader lsb read_bit", payload.size(), [&]() {
+        bit_reader<bit_order::lsb_first> reader(payload);
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < payload.size() * BYTE_SIZE; ++i)
+            sum += reader.read_bit();
+        sink = sum;
+    });
+    report("get_bit", payload.size(), [&]() {
+        std::uint64_t sum = 0;
+        for (char byte : payload) {
+            for (std::size_t j = 1; j <= BYTE_SIZE; ++j)
+                sum += huffman_decoder::get_bit(byte, j) == '1';
+        }
+        sink = sum;
+    });
+
+    report("block_splitter split", text.size(), [&]() {
+        sink = block_splitter::split(text.data(), text.size(), std::size_t(1) << 20).size();
+    });
+
+    std::string block = text.substr(0, std::size_t(1) << 20), sorted;
+    report("burrows_wheeler encode", block.size(), [&]() {
+        sorted = burrows_wheeler::encode(block);
+    });
+    std::string moved = sorted;
+    report("move_to_front encode", block.size(), [&]() {
+        moved = sorted;
+        move_to_front::encode(moved);
+    });
+    report("move_to_front decode", block.size(), [&]() {
+        std::string restored = moved;
+        move_to_front::decode(restored);
+    });
+    std::string restored(block.size(), '\0');
+    report("burrows_wheeler decode", block.size(), [&]() {
+        burrows_wheeler::decode(sorted, &restored[0], restored.size());
+    });
+    if (restored != block)
+        std::cout << "burrows_wheeler mismatch" << std::endl;
+
+    std::string output(text.size(), '\0');
+    decode_table codes(tree.get_code_to_symbol());
+    report("decode_table decode", text.size(), [&]() {
+        bit_reader<> reader(payload);
+        for (char& symbol : output)
+            codes.decode(reader, symbol);
+    });
+    if (output != text)
+        std::cout << "decode mismatch" << std::endl;
+    return 0;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "bit_reader.h"
+#include "bit_writer.h"
+#include "canonical_code.h"
+
+#include <vector>
+
+namespace huffman {
+    // Vitter's algorithm: encoder and decoder start from the same empty tree
+    // and update it after every symbol, so no table is sent and no first pass
+    // is needed. Nodes are numbered in the implicit order of the tree; weights
+    // never decrease along it and leaves precede internal nodes of the same
+    // weight. A symbol seen for the first time is sent as the code of the
+    // zero-weight leaf followed by the raw byte.
+    class adaptive_huffman {
+    public:
+        adaptive_huffman();
+
+        void encode(unsigned char symbol, bit_writer& writer);
+        void decode(bit_reader<>& reader, char& symbol);
+        std::size_t size() const;
+    private:
+        static const int NONE = -1;
+        static const int NOT_YET_TRANSMITTED = ALPHABET_SIZE;
+        struct node {
+            std::size_t weight = 0;
+            int parent = NONE;
+            int child[2] = {NONE, NONE};
+            int symbol = NONE;
+            std::size_t number = 0;
+        };
+        std::vector<node> nodes;
+        std::vector<int> order;
+        std::vector<int> leaves;
+        int root;
+
+        bool is_leaf(int index) const;
+        void swap_nodes(int first, int second);
+        int slide_and_increment(int index);
+        void update(int symbol);
+    };
+}
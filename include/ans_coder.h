@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const std::size_t ANS_TABLE_LOG = 12;
+    const std::size_t ANS_TABLE_SIZE = std::size_t(1) << ANS_TABLE_LOG;
+
+    // Table-based asymmetric numeral systems (tANS): symbol counts are scaled
+    // to a total of ANS_TABLE_SIZE and spread over as many states. A symbol
+    // costs a fractional number of bits, so skewed distributions come within
+    // a fraction of a percent of their entropy. Symbols are encoded last to
+    // first and decoded first to last with one table lookup each.
+    class ans_coder {
+    public:
+        static std::string encode(const std::string& text, const std::map<char, std::size_t>& table, std::size_t& size_of_table);
+        static std::size_t decode(const char* body, std::size_t size, char* output, std::size_t size_of_output);
+        static std::vector<std::uint32_t> normalize(const std::map<char, std::size_t>& table);
+    private:
+        struct state {
+            std::uint16_t next = 0;
+            unsigned char symbol = 0;
+            unsigned char bits = 0;
+        };
+        static std::vector<unsigned char> spread(const std::vector<std::uint32_t>& counts);
+    };
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "block_format.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const char ARCHIVE_MAGIC[] = "HUFA";
+    const unsigned char ARCHIVE_VERSION = 1;
+    const std::size_t ARCHIVE_HEADER_SIZE = BLOCK_MAGIC_SIZE + 2;
+    const std::size_t ARCHIVE_TRAILER_SIZE = 2 * sizeof(std::uint64_t) + BLOCK_MAGIC_SIZE;
+    const std::size_t ARCHIVE_BATCH_SIZE = 256;
+
+    // Members are stored as bare block sequences (no per-member file header),
+    // followed by a central directory and a fixed-size trailer pointing at it,
+    // so a member can be found without touching the others.
+    struct archive_entry {
+        std::string name;
+        std::uint64_t size_of_file = 0;
+        std::uint64_t offset = 0;
+        std::uint64_t packed_size = 0;
+        std::uint32_t block_count = 0;
+        std::uint32_t checksum = 0;
+    };
+
+    class archive_encoder {
+    public:
+        static void encode(const std::vector<std::string>& input_filenames, const std::string& output_filename, const encoder_options& options);
+        static std::string encode_member(const char* data, std::size_t size, const encoder_options& options, archive_entry& entry, std::size_t& size_of_payload);
+        static void write_directory(std::string& output, const std::vector<archive_entry>& entries, std::uint64_t directory_offset);
+    };
+
+    class archive_decoder {
+    public:
+        static std::vector<archive_entry> read_directory(const char* data, std::size_t size);
+        static void list(const std::string& input_filename);
+        static void extract(const std::string& input_filename, const std::string& output_directory, const std::vector<std::string>& names, std::size_t threads = 1);
+        static std::size_t decode_member(const archive_entry& entry, const char* data, char* output);
+    };
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace huffman {
+    enum class bit_order { msb_first, lsb_first };
+
+    // Keeps between 56 and 63 unread bits in a 64-bit container. A refill is a
+    // single unaligned 8-byte load shifted into place, without branching on the
+    // number of bits left. The next load is tracked as a byte offset that may
+    // run past the end: bytes there read as zero and no pointer leaves the
+    // buffer, so callers detect overruns by comparing position() with the size
+    // of their data.
+    template <bit_order order = bit_order::msb_first>
+    class bit_reader {
+    public:
+        bit_reader(const char* data, std::size_t size, std::size_t position = 0)
+            : begin((const unsigned char*)data), size(size), offset(position / 8) {
+            refill();
+            consume(position % 8);
+        }
+
+        explicit bit_reader(const std::string& data, std::size_t position = 0) : bit_reader(data.data(), data.size(), position) {}
+
+        void refill() {
+            if (order == bit_order::msb_first)
+                container |= load() >> count;
+            else
+                container |= load() << count;
+            offset += (63 - count) >> 3;
+            count |= 56;
+        }
+
+        // 1 <= bits <= 56, valid right after refill().
+        std::uint64_t peek(std::size_t bits) const {
+            if (order == bit_order::msb_first)
+                return container >> (64 - bits);
+            return container & ((std::uint64_t(1) << bits) - 1);
+        }
+
+        void consume(std::size_t bits) {
+            if (order == bit_order::msb_first)
+                container <<= bits;
+            else
+                container >>= bits;
+            count -= bits;
+        }
+
+        // Refills only when the container runs short, so narrow reads mostly
+        // skip the load.
+        std::uint64_t read(std::size_t bits) {
+            if (count < bits)
+                refill();
+            std::uint64_t value = peek(bits);
+            consume(bits);
+            return value;
+        }
+
+        // For decoders that walk a tree bit by bit: refills once per 56 bits
+        // instead of once per call.
+        unsigned read_bit() {
+            if (!count)
+                refill();
+            unsigned value = peek(1);
+            consume(1);
+            return value;
+        }
+
+        std::size_t position() const {
+            return offset * 8 - count;
+        }
+    private:
+        const unsigned char* begin;
+        std::size_t size;
+        std::size_t offset;
+        std::uint64_t container = 0;
+        std::size_t count = 0;
+
+        std::uint64_t load() const {
+            std::uint64_t value = 0;
+            if (offset + 8 <= size)
+                std::memcpy(&value, begin + offset, 8);
+            else if (offset < size)
+                std::memcpy(&value, begin + offset, size - offset);
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            if (order == bit_order::msb_first)
+                value = __builtin_bswap64(value);
+#else
+            if (order == bit_order::lsb_first)
+                value = __builtin_bswap64(value);
+#endif
+            return value;
+        }
+    };
+}
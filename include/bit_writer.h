@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace huffman {
+    // MSB-first counterpart of bit_reader<>: codes of up to 32 bits are shifted
+    // into a 64-bit container and whole bytes are flushed as they fill up.
+    class bit_writer {
+    public:
+        void write(std::uint32_t bits, std::size_t length) {
+            container = (container << length) | bits;
+            count += length;
+            while (count >= 8) {
+                count -= 8;
+                buffer += (char)(container >> count);
+            }
+        }
+
+        // Pads the last byte with zero bits.
+        std::string& finish() {
+            if (count) {
+                buffer += (char)(container << (8 - count));
+                count = 0;
+            }
+            return buffer;
+        }
+
+        std::size_t size() const {
+            return buffer.size() * 8 + count;
+        }
+
+        void reserve(std::size_t bytes) {
+            buffer.reserve(bytes);
+        }
+    private:
+        std::string buffer;
+        std::uint64_t container = 0;
+        std::size_t count = 0;
+    };
+}
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "canonical_code.h"
+#include "decode_table.h"
+#include "huffman.h"
+#include "lz77_coder.h"
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const char BLOCK_MAGIC[] = "HUFB";
+    const std::size_t BLOCK_MAGIC_SIZE = 4;
+    const unsigned char BLOCK_VERSION = 1;
+    const std::size_t DEFAULT_BLOCK_SIZE = 1 << 20;
+    const std::size_t MAX_BLOCK_SIZE = 1 << 26;
+    const std::size_t FILE_HEADER_SIZE = BLOCK_MAGIC_SIZE + 2 + sizeof(std::uint32_t) + 2 * sizeof(std::uint64_t);
+    const std::size_t BLOCK_HEADER_SIZE = 2 + 3 * sizeof(std::uint32_t);
+    const std::size_t ADAPTIVE_FRAME_SIZE = 2 * sizeof(std::uint32_t);
+    const std::size_t BLOCK_ENTRY_SIZE = 1;
+    const std::size_t DEFAULT_FLUSH_INTERVAL = 100;
+    const std::size_t MAX_DELTA_CHANGES = 255;
+    const std::size_t AUTO_SAMPLE_SIZE = 1 << 16;
+    const double AUTO_MIN_GAIN = 0.02;
+    const std::size_t MIN_LEVEL = 1;
+    const std::size_t MAX_LEVEL = 9;
+    const std::size_t DEFAULT_LEVEL = 2;
+
+    enum block_coder : unsigned char {
+        CODER_HUFFMAN = 0,
+        CODER_CONSTANT = 1,
+        CODER_STORED = 2,
+        CODER_ADAPTIVE = 3,
+        CODER_CONTEXT = 4,
+        CODER_DIGRAM = 5,
+        CODER_LZ77 = 6,
+        CODER_ANS = 7,
+        CODER_RANGE = 8,
+        CODER_END = 0xff
+    };
+
+    const char* const CODER_NAMES[] = {"huffman", "constant", "stored", "adaptive", "context", "digram", "lz77", "ans", "range"};
+
+    enum block_transform : unsigned char {
+        TRANSFORM_RUN_LENGTH = 1,
+        // burrows_wheeler then move_to_front, applied before run_length.
+        TRANSFORM_BURROWS_WHEELER = 2,
+        // delta_filter, applied first.
+        TRANSFORM_DELTA = 4
+    };
+
+    enum file_flag : unsigned char {
+        FLAG_STREAM = 1,
+        // Adaptive frames with one model for the whole member (see stream_encoder).
+        FLAG_ADAPTIVE = 2
+    };
+
+    // A Huffman table is either sent in full (with an optional escape symbol),
+    // or taken from the previous Huffman block as is, or as (symbol, length)
+    // changes against it.
+    enum huffman_table_flag : unsigned char {
+        TABLE_ESCAPE = 1,
+        TABLE_REUSE = 2,
+        TABLE_DELTA = 4
+    };
+
+    struct file_header {
+        unsigned char version = BLOCK_VERSION;
+        unsigned char flags = 0;
+        std::uint32_t block_size = 0;
+        std::uint64_t block_count = 0;
+        std::uint64_t size_of_file = 0;
+    };
+
+    // raw_size bytes of the original file, passed through `transforms` into
+    // coded_size symbols, which `coder` packs into the packed_size bytes that follow.
+    struct block_header {
+        unsigned char coder = CODER_HUFFMAN;
+        unsigned char transforms = 0;
+        std::uint32_t raw_size = 0;
+        std::uint32_t coded_size = 0;
+        std::uint32_t packed_size = 0;
+    };
+
+    struct encoder_options {
+        unsigned char coder = CODER_HUFFMAN;
+        std::size_t block_size = DEFAULT_BLOCK_SIZE;
+        std::size_t threads = 1;
+        std::size_t max_code_length = MAX_CODE_LENGTH;
+        std::size_t flush_interval = DEFAULT_FLUSH_INTERVAL;
+        bool escape_rare = false;
+        // Try burrows_wheeler on every block, kept where it is estimated to pay off.
+        bool sort_blocks = false;
+        // Try the delta_filter chosen on a sample of every block.
+        bool filter_blocks = false;
+        // Match candidates tried per position by CODER_LZ77.
+        std::size_t match_depth = DEFAULT_MATCH_DEPTH;
+        // The coder and filter of every block are picked by trial on a sample.
+        // A coder other than CODER_HUFFMAN is still tried on the whole block and kept if smaller.
+        bool auto_select = false;
+        // run_length is tried on the whole block only if it pays off on a sample.
+        bool sample_decisions = false;
+        // Boundaries follow the data, block_size only caps the block length.
+        bool adaptive = false;
+        std::size_t shard_index = 0;
+        std::size_t shard_count = 1;
+        bool append = false;
+    };
+
+    struct huffman_table {
+        huffman_table(const std::vector<unsigned char>& lengths, int escape);
+
+        std::vector<unsigned char> lengths;
+        int escape;
+        decode_table table;
+    };
+
+    // What the encoder decided for a block before any bits are written.
+    struct block_plan {
+        block_header header;
+        std::string text;
+        std::map<char, std::size_t> table;
+        std::vector<unsigned char> lengths;
+        int escape = NO_ESCAPE;
+        std::string table_bytes;
+        std::size_t match_depth = DEFAULT_MATCH_DEPTH;
+        // Set when plan_block already encoded the block with body_coder to compare coders.
+        std::string body;
+        std::size_t size_of_table = 0;
+        unsigned char body_coder = CODER_HUFFMAN;
+    };
+
+    class block_encoder {
+    public:
+        static void encode(const std::string& input_filename, const std::string& output_filename, const encoder_options& options);
+        static std::string encode_block(const char* data, std::size_t size, const encoder_options& options, block_header& header, std::size_t& size_of_table);
+        static std::string encode_block(const char* data, std::size_t size, const encoder_options& options, block_header& header, std::size_t& size_of_table, std::vector<unsigned char>& previous);
+        static block_plan plan_block(const char* data, std::size_t size, const encoder_options& options);
+        static void choose_table(block_plan& plan, std::vector<unsigned char>& previous);
+        static std::string encode_plan(const block_plan& plan, const char* data, block_header& header, std::size_t& size_of_table);
+        static std::vector<code_word> get_code_words(const block_plan& plan);
+        static std::size_t get_append_offset(const std::string& output_filename);
+        static std::string get_sample(const std::string& text);
+        static unsigned char choose_coder(const std::string& text, const encoder_options& options);
+        static std::string encode_text(unsigned char coder, const block_plan& plan, std::size_t& size_of_table);
+        static unsigned char get_coder(const std::string& name);
+        static encoder_options get_level(std::size_t level);
+        static std::string get_mode_name(const block_header& header);
+        static void write_file_header(std::string& output, const file_header& header);
+        static void write_block_header(std::string& output, const block_header& header);
+    };
+
+    class block_decoder {
+    public:
+        struct block_entry {
+            block_header header;
+            std::size_t body_offset = 0;
+            std::size_t output_offset = 0;
+            std::shared_ptr<const huffman_table> table;
+            std::size_t size_of_table = 0;
+            // Frames of an adaptive member share one model. The first one holds
+            // the number of frames, which are decoded together, the rest 0.
+            std::size_t frames = 0;
+        };
+
+        static bool is_block_file(std::ifstream& file);
+        static void decode(const std::string& input_filename, const std::string& output_filename, std::size_t threads = 1);
+        static void decode_range(const std::string& input_filename, const std::string& output_filename, std::size_t begin, std::size_t end);
+        static std::size_t decode_block(const block_header& header, const char* body, char* output, std::shared_ptr<const huffman_table>& table);
+        static std::size_t decode_block(const block_header& header, const char* body, char* output, const huffman_table* table, std::size_t size_of_table);
+        static std::size_t read_table(const char* body, std::size_t size, std::shared_ptr<const huffman_table>& table);
+        static void decode_huffman(const char* body, std::size_t size, char* output, std::size_t size_of_output, const huffman_table& table, std::size_t size_of_table);
+        static file_header read_file_header(const char* data, std::size_t size);
+        static block_header read_block_header(const char* data, std::size_t size);
+        static std::vector<block_entry> read_blocks(const char* data, std::size_t size, file_header& header);
+        static block_header read_frame_header(const char* data, std::size_t size);
+        static void decode_frames(const char* data, const block_entry* frames, std::size_t count, char* output);
+    };
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+namespace huffman {
+    const std::size_t SPLIT_WINDOW = 1 << 14;
+    const std::size_t SPLIT_OVERHEAD_BITS = (14 + 33) * 8;
+
+    typedef std::array<std::uint32_t, 256> histogram;
+
+    // Places block boundaries where byte statistics change. Input is scanned in
+    // SPLIT_WINDOW steps; a window starts a new block when the entropy of the
+    // current block and of the window taken apart, plus the cost of one more
+    // header and table, is below the entropy of the two merged.
+    class block_splitter {
+    public:
+        static std::vector<std::size_t> split(const char* data, std::size_t size, std::size_t max_block_size);
+        static void count(const char* data, std::size_t size, histogram& counts);
+        static double get_cost(const histogram& counts);
+    };
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const std::size_t MAX_CODE_LENGTH = 24;
+    const std::size_t ALPHABET_SIZE = 256;
+
+    struct code_word {
+        std::uint32_t bits = 0;
+        unsigned char length = 0;
+    };
+
+    // Codes are assigned in order of (length, symbol), so a table is fully
+    // described by the code length of every symbol.
+    class canonical_code {
+    public:
+        static std::vector<unsigned char> get_lengths(const std::map<char, std::size_t>& table, std::size_t max_length = MAX_CODE_LENGTH);
+        static std::vector<unsigned char> get_lengths(const std::vector<std::size_t>& counts, std::size_t max_length = MAX_CODE_LENGTH);
+        static std::vector<code_word> get_code_words(const std::vector<unsigned char>& lengths);
+        static std::map<std::string, char> get_code_to_symbol(const std::vector<unsigned char>& lengths);
+        static std::size_t get_encoded_bits(const std::map<char, std::size_t>& table, const std::vector<unsigned char>& lengths);
+        static void write_lengths(std::string& output, const std::vector<unsigned char>& lengths);
+        static std::size_t read_lengths(const char* data, std::size_t size, std::vector<unsigned char>& lengths);
+    };
+}
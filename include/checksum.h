@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace huffman {
+    class checksum {
+    public:
+        // CRC-32 (IEEE 802.3), `crc` continues a previous call.
+        static std::uint32_t crc32(const char* data, std::size_t size, std::uint32_t crc = 0);
+    };
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "block_splitter.h"
+#include "canonical_code.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const std::size_t CONTEXT_CODE_LENGTH = 10;
+    const std::size_t MAX_CONTEXT_TABLES = 32;
+    const std::size_t CONTEXT_TABLE_OVERHEAD_BITS = (ALPHABET_SIZE / 8 + 1) * 8;
+
+    // Order-1 coding: every byte is coded with the table of the context its
+    // predecessor belongs to. Contexts with similar statistics share a table,
+    // the number of tables is chosen by estimated size. Codes are at most
+    // CONTEXT_CODE_LENGTH bits, so each table decodes with a single 2 KB lookup.
+    class context_coder {
+    public:
+        static std::string encode(const std::string& text, std::size_t& size_of_table);
+        static std::size_t decode(const char* body, std::size_t size, char* output, std::size_t size_of_output);
+    private:
+        static std::vector<unsigned char> get_clusters(const std::vector<histogram>& contexts, std::size_t& count);
+        static double assign(const std::vector<histogram>& contexts, std::size_t count, std::vector<unsigned char>& clusters);
+        static std::size_t get_index_bits(std::size_t count);
+    };
+}
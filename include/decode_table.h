@@ -0,0 +1,97 @@
+#pragma once
+
+#include "bit_reader.h"
+#include "huffman.h"
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const std::size_t LOOKUP_BITS = 11;
+
+    // Codes up to LOOKUP_BITS long are resolved by a single lookup of the next
+    // LOOKUP_BITS bits; longer codes continue bit by bit down the code tree.
+    class decode_table {
+    public:
+        explicit decode_table(const std::map<std::string, char>& codes, int escape = NO_ESCAPE);
+        bool decode(bit_reader<>& reader, char& symbol) const;
+    private:
+        static const unsigned short INVALID = 0xffff;
+        int escape;
+        struct entry {
+            char symbol = 0;
+            unsigned char length = 0;
+            unsigned short node = INVALID;
+        };
+        struct node {
+            unsigned short child[2] = {INVALID, INVALID};
+            char symbol = 0;
+        };
+        std::vector<entry> lookup;
+        std::vector<node> nodes;
+    };
+
+    // Canonical codes of an alphabet of any size, given by their lengths (see
+    // canonical_code). Codes up to LOOKUP_BITS long take one lookup, longer
+    // ones are found by comparing with the first code of each length.
+    class canonical_table {
+    public:
+        canonical_table(const std::vector<unsigned char>& lengths, std::size_t max_length);
+        bool decode(bit_reader<>& reader, std::uint32_t& symbol) const;
+    private:
+        std::size_t max_length;
+        std::vector<std::uint32_t> lookup;
+        std::vector<std::uint32_t> first_code;
+        std::vector<std::uint32_t> first_index;
+        std::vector<std::uint32_t> counts;
+        std::vector<std::uint32_t> symbols;
+    };
+
+    inline bool canonical_table::decode(bit_reader<>& reader, std::uint32_t& symbol) const {
+        reader.refill();
+        std::uint32_t item = lookup[reader.peek(LOOKUP_BITS)];
+        if (item & 0xff) {
+            reader.consume(item & 0xff);
+            symbol = item >> 8;
+            return true;
+        }
+        std::uint32_t code = reader.peek(max_length);
+        for (std::size_t length = LOOKUP_BITS + 1; length <= max_length; ++length) {
+            std::uint32_t offset = (code >> (max_length - length)) - first_code[length];
+            if (offset < counts[length]) {
+                reader.consume(length);
+                symbol = symbols[first_index[length] + offset];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // The escape symbol is followed by the raw byte it stands for.
+    inline bool decode_table::decode(bit_reader<>& reader, char& symbol) const {
+        reader.refill();
+        const entry& item = lookup[reader.peek(LOOKUP_BITS)];
+        if (item.length) {
+            reader.consume(item.length);
+            symbol = item.symbol;
+            if ((unsigned char)symbol == escape)
+                symbol = (char)reader.read(BYTE_SIZE);
+            return true;
+        }
+        if (item.node == INVALID)
+            return false;
+        reader.consume(LOOKUP_BITS);
+        unsigned short current = item.node;
+        while (nodes[current].child[0] != INVALID) {
+            current = nodes[current].child[reader.read_bit()];
+            if (current == INVALID)
+                return false;
+        }
+        symbol = nodes[current].symbol;
+        if ((unsigned char)symbol == escape)
+            symbol = (char)reader.read(BYTE_SIZE);
+        return true;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "canonical_code.h"
+#include "decode_table.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const char DICTIONARY_MAGIC[] = "HUFD";
+    const char MESSAGE_MAGIC[] = "HUFM";
+    const unsigned char DICTIONARY_VERSION = 1;
+    const std::size_t MESSAGE_HEADER_SIZE = 4 + 2 * sizeof(std::uint32_t);
+
+    // A code table trained on a corpus and shared out of band. Every byte has
+    // a code, so any message can be encoded with it, and messages only carry
+    // the dictionary id instead of a table.
+    struct dictionary {
+        std::uint32_t id = 0;
+        std::vector<unsigned char> lengths;
+        std::vector<code_word> words;
+        std::shared_ptr<const decode_table> table;
+    };
+
+    class dictionary_trainer {
+    public:
+        static dictionary train(const std::vector<std::string>& input_filenames, std::size_t max_length = MAX_CODE_LENGTH);
+        static dictionary make_dictionary(const std::vector<unsigned char>& lengths);
+        static void write(const dictionary& shared, const std::string& output_filename);
+    };
+
+    class dictionary_encoder {
+    public:
+        static void encode(const std::string& dictionary_filename, const std::string& input_filename, const std::string& output_filename);
+        static std::string encode_message(const dictionary& shared, const char* data, std::size_t size);
+    };
+
+    class dictionary_decoder {
+    public:
+        static dictionary read(const std::string& dictionary_filename);
+        static void decode(const std::string& dictionary_filename, const std::string& input_filename, const std::string& output_filename);
+        static std::string decode_message(const dictionary& shared, const char* data, std::size_t size);
+    };
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "canonical_code.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const std::size_t MAX_DIGRAMS = 4096 - ALPHABET_SIZE;
+    const std::size_t DIGRAM_CODE_LENGTH = 16;
+
+    // Codes over an extended alphabet: the 256 bytes plus the most frequent
+    // byte pairs. Text is parsed greedily, a pair outside the chosen set is sent
+    // as two byte symbols. One decoded symbol yields one or two bytes.
+    class digram_coder {
+    public:
+        static std::string encode(const std::string& text, std::size_t& size_of_table);
+        static std::size_t decode(const char* body, std::size_t size, char* output, std::size_t size_of_output);
+    private:
+        struct digram {
+            unsigned char count = 0;
+            char bytes[2] = {0, 0};
+        };
+        static std::vector<std::uint32_t> parse(const std::string& text, const std::vector<std::uint16_t>& digrams, std::vector<std::size_t>& counts);
+        static double get_cost(const std::vector<std::size_t>& counts);
+    };
+}
@@ -3,26 +3,47 @@
 #include <fstream>
 #include <map>
 #include <string>
+#include <vector>
 
 namespace huffman {
+    class decode_table;
+
     const std::size_t BYTE_SIZE = 8;
+    const std::size_t INDEX_INTERVAL = 1 << 16;
+    const char INDEX_MAGIC[] = "HUFINDEX";
+    const std::size_t RUN_LENGTH_FLAG = std::size_t(1) << (sizeof(std::size_t) * BYTE_SIZE - 1);
+    const std::size_t ESCAPE_FLAG = RUN_LENGTH_FLAG >> 1;
+    const int NO_ESCAPE = -1;
+    const std::size_t LEGACY_ENTRY_SIZE = 1 + sizeof(std::size_t);
 
 
     class huffman_encoder {
     public:
-        static void encode(const std::string& input_filename, const std::string& output_filename);
+        static void encode(const std::string& input_filename, const std::string& output_filename, std::size_t index_interval = 0, bool escape_rare = false);
         static std::map<char, std::size_t> get_table(std::ifstream& file);
+        static std::map<char, std::size_t> get_table(const std::string& text);
         static std::string get_encoded_text(std::ifstream& file, std::map<char, std::string>& codes, std::size_t& size_of_file);
-        static std::size_t write_additional_information(std::ofstream& file, std::map<char, std::size_t>& table, std::size_t size_of_file);
+        static std::string get_encoded_text(const std::string& text, std::map<char, std::string>& codes, std::vector<std::size_t>& index, std::size_t index_interval);
+        static std::size_t get_encoded_size(const std::map<char, std::size_t>& table, std::size_t entry_size = LEGACY_ENTRY_SIZE);
+        static std::size_t get_optimal_bits(const std::vector<std::size_t>& counts);
+        static std::size_t fold_rare_symbols(std::map<char, std::size_t>& table, char& escape, std::size_t entry_size = LEGACY_ENTRY_SIZE);
+        static std::map<char, std::string> get_codes(const std::map<char, std::size_t>& table, const std::map<char, std::size_t>& folded, int escape);
+        static std::size_t write_additional_information(std::ofstream& file, std::map<char, std::size_t>& table, std::size_t size_of_file, std::size_t size_of_runs = 0, int escape = NO_ESCAPE);
         static void write_encoded_text(std::ofstream& file, const std::string& text);
+        static std::size_t write_index(std::ofstream& file, const std::vector<std::size_t>& index, std::size_t index_interval);
     };
 
     class huffman_decoder {
     public:
-        static void decode(const std::string& input_filename, const std::string& output_filename);
+        static void decode(const std::string& input_filename, const std::string& output_filename, std::size_t threads = 1);
+        static void decode_range(const std::string& input_filename, const std::string& output_filename, std::size_t begin, std::size_t end);
         static char get_bit(char& byte, std::size_t index);
-        static std::size_t get_additional_information(std::ifstream& file, std::map<char, std::size_t>& table, std::size_t& size_of_file);
-        static std::size_t write_decoded_text(std::ofstream& output_file, std::ifstream& input_file, std::map<std::string, char> codes, std::size_t size_of_file);
+        static std::size_t get_additional_information(std::ifstream& file, std::map<char, std::size_t>& table, std::size_t& size_of_file, std::size_t& size_of_runs, int& escape);
+        static std::map<std::string, char> get_codes(const std::map<char, std::size_t>& table);
+        static std::size_t get_index(std::ifstream& file, std::vector<std::size_t>& index, std::size_t& index_interval);
+        static std::size_t write_decoded_text(char* output, std::ifstream& input_file, const decode_table& table, std::size_t size_of_file);
+        static std::size_t write_decoded_text_parallel(char* output, std::ifstream& input_file, const decode_table& table, std::size_t size_of_file, std::size_t threads);
+        static std::string get_payload(std::ifstream& input_file);
     };
     
     class huffman_node {
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const std::size_t MIN_MATCH = 3;
+    const std::size_t MAX_MATCH = MIN_MATCH + 0xffff;
+    const std::size_t FAR_MATCH_DISTANCE = 1 << 12;
+    const std::size_t MATCH_HASH_BITS = 16;
+    const std::size_t DEFAULT_MATCH_DEPTH = 16;
+    const std::size_t LENGTH_CODES = 32;
+    const std::size_t DISTANCE_CODES = 52;
+    const std::size_t LITERAL_CODES = 256 + LENGTH_CODES;
+    const std::size_t LZ77_CODE_LENGTH = 15;
+
+    // Deflate-style coding: a hash-chain match finder with one step of lazy
+    // evaluation turns the block into literals and (length, distance) matches
+    // reaching back anywhere in the block. Literals and length codes share one
+    // Huffman alphabet, distance codes have their own; both codes are followed
+    // by extra bits. depth bounds the candidates tried per position.
+    class lz77_coder {
+    public:
+        static std::string encode(const std::string& text, std::size_t depth, std::size_t& size_of_table);
+        static std::size_t decode(const char* body, std::size_t size, char* output, std::size_t size_of_output);
+        static void get_code(std::uint32_t value, std::uint32_t& code, std::uint32_t& extra_bits);
+    private:
+        struct token {
+            std::uint32_t length = 0;
+            std::uint32_t value = 0;
+        };
+        static std::vector<token> find_matches(const std::string& text, std::size_t depth);
+    };
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+
+namespace huffman {
+    class mapped_output {
+    public:
+        mapped_output(const std::string& filename, std::size_t size);
+        ~mapped_output();
+        mapped_output(const mapped_output&) = delete;
+        mapped_output& operator=(const mapped_output&) = delete;
+
+        char* data();
+        std::size_t size() const;
+        bool is_mapped() const;
+        void close();
+    private:
+        std::string filename;
+        int descriptor = -1;
+        bool regular = false;
+        char* memory = nullptr;
+        std::size_t length = 0;
+        std::string fallback;
+    };
+
+    class mapped_input {
+    public:
+        explicit mapped_input(const std::string& filename);
+        ~mapped_input();
+        mapped_input(const mapped_input&) = delete;
+        mapped_input& operator=(const mapped_input&) = delete;
+
+        const char* data() const;
+        std::size_t size() const;
+    private:
+        const char* memory = nullptr;
+        std::size_t length = 0;
+        bool mapped = false;
+        std::string fallback;
+    };
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "decode_table.h"
+#include "huffman.h"
+
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const std::size_t SYNC_WINDOW_BITS = 4096;
+    const std::size_t MIN_CHUNK_BITS = 1 << 16;
+
+    class parallel_decoder {
+    public:
+        static std::size_t decode(const std::string& payload, const decode_table& table, char* output, std::size_t size_of_file, std::size_t threads);
+    private:
+        struct chunk {
+            std::size_t begin_bit = 0;
+            std::size_t end_bit = 0;
+            std::size_t entry_bit = 0;
+            std::size_t exit_bit = 0;
+            std::size_t count = 0;
+            std::vector<std::size_t> boundaries;
+        };
+        static void count_chunk(const std::string& payload, const decode_table& table, chunk& part);
+        static void synchronize(const std::string& payload, const decode_table& table, chunk& part, std::size_t entry_bit);
+        static void decode_chunk(const std::string& payload, const decode_table& table, const chunk& part, char* output, std::size_t count);
+    };
+}
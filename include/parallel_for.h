@@ -0,0 +1,9 @@
+#pragma once
+
+#include <functional>
+
+namespace huffman {
+    // Runs job(0) ... job(count - 1) on up to `threads` threads, the calling one
+    // included. The first exception thrown by a job is rethrown after all join.
+    void parallel_for(std::size_t count, std::size_t threads, const std::function<void(std::size_t)>& job);
+}
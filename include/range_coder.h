@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const std::size_t PROBABILITY_BITS = 11;
+    const std::uint32_t PROBABILITY_ONE = 1 << PROBABILITY_BITS;
+    const std::size_t ADAPTATION_SHIFT = 4;
+    const std::uint32_t RANGE_TOP = 1 << 24;
+
+    enum range_model : unsigned char {
+        RANGE_STATIC = 0,
+        RANGE_ORDER0 = 1,
+        RANGE_ORDER1 = 2
+    };
+
+    // Binary range coder in the style of LZMA: each bit is coded with an
+    // 11-bit probability of it being zero. Adaptive probabilities move
+    // towards every coded bit.
+    class range_encoder {
+    public:
+        void encode(std::uint16_t& probability, unsigned bit);
+        void encode_fixed(std::uint16_t probability, unsigned bit);
+        std::string& finish();
+    private:
+        std::string output;
+        std::uint64_t low = 0;
+        std::uint32_t range = 0xffffffff;
+        unsigned char cache = 0;
+        std::size_t cache_size = 1;
+
+        void shift_low();
+    };
+
+    class range_decoder {
+    public:
+        range_decoder(const char* data, std::size_t size);
+        unsigned decode(std::uint16_t& probability);
+        unsigned decode_fixed(std::uint16_t probability);
+        std::size_t position() const;
+    private:
+        const unsigned char* data;
+        std::size_t size;
+        std::size_t current = 0;
+        std::uint32_t range = 0xffffffff;
+        std::uint32_t code = 0;
+
+        unsigned char next();
+    };
+
+    // Bytes are coded bit by bit down a binary tree of 255 probabilities,
+    // either fixed ones sent with the block (RANGE_STATIC) or adaptive ones,
+    // one tree for the block (RANGE_ORDER0) or one per previous byte
+    // (RANGE_ORDER1). The encoder tries all three and keeps the smallest.
+    class range_coder {
+    public:
+        static std::string encode(const std::string& text, std::size_t& size_of_table);
+        static std::string encode(const std::string& text, unsigned char model, std::size_t& size_of_table);
+        static std::size_t decode(const char* body, std::size_t size, char* output, std::size_t size_of_output);
+    };
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "block_format.h"
+
+#include <string>
+
+namespace huffman {
+    const char STANDARD_STREAM[] = "-";
+    const std::size_t READ_CHUNK_SIZE = 1 << 16;
+
+    class file_descriptor {
+    public:
+        file_descriptor(const std::string& filename, bool output, bool append = false);
+        ~file_descriptor();
+        file_descriptor(const file_descriptor&) = delete;
+        file_descriptor& operator=(const file_descriptor&) = delete;
+
+        int get() const;
+        bool read_exact(char* data, std::size_t size);
+        void write_all(const char* data, std::size_t size);
+    private:
+        int descriptor;
+        bool owned;
+    };
+
+    // Block files written front to back: the header carries FLAG_STREAM instead
+    // of counts, every block goes out as soon as it is full or the input has
+    // been idle for flush_interval milliseconds, and a CODER_END frame closes
+    // the stream. "-" names standard input or output.
+    //
+    // With CODER_ADAPTIVE nothing is buffered: whatever one read returns is
+    // coded at once with a single adaptive_huffman model for the whole stream
+    // and sent as a frame of its byte count, packed size and bits. An empty
+    // frame closes the stream, the header carries FLAG_ADAPTIVE as well.
+    class stream_encoder {
+    public:
+        static void encode(const std::string& input_filename, const std::string& output_filename, const encoder_options& options);
+    private:
+        static void encode_adaptive(const std::string& input_filename, const std::string& output_filename, const encoder_options& options);
+    };
+
+    class stream_decoder {
+    public:
+        static void decode(const std::string& input_filename, const std::string& output_filename);
+    private:
+        static std::size_t decode_adaptive(file_descriptor& input, file_descriptor& output, std::size_t& size_of_payload, std::size_t& additional_information);
+    };
+}
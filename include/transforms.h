@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace huffman {
+    const std::size_t RUN_THRESHOLD = 4;
+    const std::size_t MAX_RUN_EXTENSION = 255;
+    const std::size_t BWT_INDEX_SIZE = sizeof(std::uint32_t);
+    const std::size_t MAX_SORTED_SIZE = (1 << 24) - 1;
+    const std::size_t FILTER_SAMPLE_SIZE = 1 << 16;
+    const std::size_t MAX_FILTER_STRIDE = 16;
+
+    // The low bits of a filter are its stride, the flags say what is done with it.
+    enum filter_flag : unsigned char {
+        FILTER_PLANES = 0x40,
+        FILTER_DELTA = 0x80
+    };
+
+    // Runs of RUN_THRESHOLD equal bytes are followed by one byte holding the
+    // number of further repetitions, as in the first stage of bzip2.
+    class run_length {
+    public:
+        static std::string encode(const std::string& text);
+        static void decode(const std::string& runs, char* output, std::size_t size_of_output);
+    };
+
+    // Burrows-Wheeler transform of the text terminated by a virtual end symbol
+    // smaller than any byte: the row of that symbol is written first (4 bytes),
+    // then the last column without it. Rows are sorted with a suffix array
+    // built in linear time by induced sorting (SA-IS). Texts are at most
+    // MAX_SORTED_SIZE bytes, so that a row number and a byte share 32 bits.
+    class burrows_wheeler {
+    public:
+        static std::string encode(const std::string& text);
+        static void decode(const std::string& sorted, char* output, std::size_t size_of_output);
+        static std::vector<std::uint32_t> get_suffix_array(const std::string& text);
+    private:
+        static void sort_suffixes(const std::int32_t* text, std::int32_t* suffixes, std::size_t size, std::size_t alphabet);
+        static void induce(const std::int32_t* text, std::int32_t* suffixes, std::size_t size, std::size_t alphabet, const std::vector<unsigned char>& small);
+        static void get_buckets(const std::int32_t* text, std::size_t size, std::size_t alphabet, std::vector<std::int32_t>& buckets, bool ends);
+    };
+
+    // Turns the local repetitions left by burrows_wheeler into runs of small
+    // numbers, zeros mostly, which run_length then shortens.
+    class move_to_front {
+    public:
+        static void encode(std::string& text);
+        static void decode(std::string& text);
+    };
+
+    // Reversible filters for numeric data, written as the filter byte followed
+    // by the filtered text. FILTER_DELTA alone replaces every byte by its
+    // difference with the byte stride positions back (integers and structs of
+    // that size), FILTER_PLANES splits the text into stride byte planes (the
+    // exponent and mantissa bytes of floats), with FILTER_DELTA as well each
+    // plane is then delta coded.
+    class delta_filter {
+    public:
+        static unsigned char choose(const char* data, std::size_t size);
+        static std::string encode(const std::string& text, unsigned char filter);
+        static void decode(const std::string& filtered, char* output, std::size_t size_of_output);
+    };
+}
@@ -0,0 +1,125 @@
+#include "adaptive_huffman.h"
+#include "huffman.h"
+#include <algorithm>
+
+using namespace huffman;
+
+const int adaptive_huffman::NONE;
+const int adaptive_huffman::NOT_YET_TRANSMITTED;
+
+adaptive_huffman::adaptive_huffman() : nodes(1), order(2 * ALPHABET_SIZE + 1, NONE), leaves(ALPHABET_SIZE + 1, NONE), root(0) {
+    nodes[0].symbol = NOT_YET_TRANSMITTED;
+    nodes[0].number = order.size() - 1;
+    order[nodes[0].number] = 0;
+    leaves[NOT_YET_TRANSMITTED] = 0;
+}
+
+std::size_t adaptive_huffman::size() const {
+    return nodes[root].weight;
+}
+
+bool adaptive_huffman::is_leaf(int index) const {
+    return nodes[index].child[0] == NONE;
+}
+
+// Exchanges the places of two subtrees, neither of which contains the other.
+void adaptive_huffman::swap_nodes(int first, int second) {
+    node& a = nodes[first];
+    node& b = nodes[second];
+    int a_side = nodes[a.parent].child[1] == first, b_side = nodes[b.parent].child[1] == second;
+    nodes[a.parent].child[a_side] = second;
+    nodes[b.parent].child[b_side] = first;
+    std::swap(a.parent, b.parent);
+    std::swap(a.number, b.number);
+    order[a.number] = first;
+    order[b.number] = second;
+}
+
+// Moves the node past the block that must follow it once its weight grows
+// (internal nodes of the same weight for a leaf, leaves of the next weight
+// for an internal node), increments it and returns the next node to update.
+int adaptive_huffman::slide_and_increment(int index) {
+    int former_parent = nodes[index].parent;
+    std::size_t weight = nodes[index].weight;
+    bool leaf = is_leaf(index);
+    while (nodes[index].number + 1 < order.size()) {
+        int next = order[nodes[index].number + 1];
+        if (leaf ? (is_leaf(next) || nodes[next].weight != weight) : (!is_leaf(next) || nodes[next].weight != weight + 1))
+            break;
+        swap_nodes(index, next);
+    }
+    ++nodes[index].weight;
+    return leaf ? nodes[index].parent : former_parent;
+}
+
+void adaptive_huffman::update(int symbol) {
+    int current = leaves[symbol], leaf_to_increment = NONE;
+    if (current == NONE) {
+        int zero = leaves[NOT_YET_TRANSMITTED];
+        std::size_t number = nodes[zero].number;
+        nodes.resize(nodes.size() + 2);
+        int new_zero = nodes.size() - 2, leaf = nodes.size() - 1;
+        nodes[zero].symbol = NONE;
+        nodes[zero].child[0] = new_zero;
+        nodes[zero].child[1] = leaf;
+        nodes[new_zero].parent = nodes[leaf].parent = zero;
+        nodes[new_zero].symbol = NOT_YET_TRANSMITTED;
+        nodes[leaf].symbol = symbol;
+        nodes[leaf].number = number - 1;
+        nodes[new_zero].number = number - 2;
+        order[number - 1] = leaf;
+        order[number - 2] = new_zero;
+        leaves[NOT_YET_TRANSMITTED] = new_zero;
+        leaves[symbol] = leaf;
+        current = zero;
+        leaf_to_increment = leaf;
+    }
+    else {
+        int leader = current;
+        while (nodes[leader].number + 1 < order.size()) {
+            int next = order[nodes[leader].number + 1];
+            if (!is_leaf(next) || nodes[next].weight != nodes[current].weight)
+                break;
+            leader = next;
+        }
+        if (leader != current)
+            swap_nodes(current, leader);
+        if (nodes[current].parent == nodes[leaves[NOT_YET_TRANSMITTED]].parent) {
+            leaf_to_increment = current;
+            current = nodes[current].parent;
+        }
+    }
+    while (current != NONE)
+        current = slide_and_increment(current);
+    if (leaf_to_increment != NONE)
+        slide_and_increment(leaf_to_increment);
+}
+
+void adaptive_huffman::encode(unsigned char symbol, bit_writer& writer) {
+    int current = leaves[symbol] != NONE ? leaves[symbol] : leaves[NOT_YET_TRANSMITTED];
+    unsigned char path[ALPHABET_SIZE + 1];
+    std::size_t length = 0;
+    for (; current != root; current = nodes[current].parent)
+        path[length++] = nodes[nodes[current].parent].child[1] == current;
+    while (length) {
+        std::uint32_t bits = 0;
+        std::size_t count = std::min<std::size_t>(length, 24);
+        for (std::size_t i = 0; i < count; ++i)
+            bits = (bits << 1) | path[--length];
+        writer.write(bits, count);
+    }
+    if (leaves[symbol] == NONE)
+        writer.write(symbol, BYTE_SIZE);
+    update(symbol);
+}
+
+void adaptive_huffman::decode(bit_reader<>& reader, char& symbol) {
+    int current = root;
+    while (!is_leaf(current))
+        current = nodes[current].child[reader.read_bit()];
+    int value = nodes[current].symbol;
+    if (value == NOT_YET_TRANSMITTED)
+        value = reader.read(BYTE_SIZE);
+    symbol = value;
+    update(value);
+}
@@ -0,0 +1,135 @@
+#include "ans_coder.h"
+#include "bit_reader.h"
+#include "bit_writer.h"
+#include "canonical_code.h"
+#include "huffman.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace huffman;
+
+// Every present symbol keeps at least one state; rounding errors are settled
+// on the most frequent symbols.
+std::vector<std::uint32_t> ans_coder::normalize(const std::map<char, std::size_t>& table) {
+    std::vector<std::uint32_t> counts(ALPHABET_SIZE, 0);
+    std::uint64_t total = 0;
+    for (const std::pair<const char, std::size_t>& symbol : table)
+        total += symbol.second;
+    std::size_t assigned = 0, largest = 0;
+    for (const std::pair<const char, std::size_t>& symbol : table) {
+        unsigned char index = symbol.first;
+        counts[index] = std::max<std::uint64_t>(1, (symbol.second * ANS_TABLE_SIZE + total / 2) / total);
+        assigned += counts[index];
+        if (counts[index] > counts[largest])
+            largest = index;
+    }
+    while (assigned > ANS_TABLE_SIZE) {
+        std::size_t index = std::max_element(counts.begin(), counts.end()) - counts.begin();
+        std::uint32_t excess = std::min<std::size_t>(assigned - ANS_TABLE_SIZE, counts[index] / 2);
+        counts[index] -= excess;
+        assigned -= excess;
+    }
+    counts[largest] += ANS_TABLE_SIZE - assigned;
+    return counts;
+}
+
+// Scatters the states of each symbol over the table with a step coprime to
+// its size, as FSE does, so that neighbouring states hold different symbols.
+std::vector<unsigned char> ans_coder::spread(const std::vector<std::uint32_t>& counts) {
+    std::vector<unsigned char> symbols(ANS_TABLE_SIZE);
+    std::size_t step = (ANS_TABLE_SIZE >> 1) + (ANS_TABLE_SIZE >> 3) + 3, position = 0;
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+        for (std::uint32_t i = 0; i < counts[symbol]; ++i) {
+            symbols[position] = symbol;
+            position = (position + step) & (ANS_TABLE_SIZE - 1);
+        }
+    }
+    return symbols;
+}
+
+std::string ans_coder::encode(const std::string& text, const std::map<char, std::size_t>& table, std::size_t& size_of_table) {
+    std::vector<std::uint32_t> counts = normalize(table);
+    std::string body(ALPHABET_SIZE / 8, '\0');
+    std::vector<std::uint32_t> starts(ALPHABET_SIZE + 1, 0);
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+        starts[symbol + 1] = starts[symbol] + counts[symbol];
+        if (!counts[symbol])
+            continue;
+        body[symbol / 8] |= 1 << (symbol % 8);
+        body += (char)((counts[symbol] - 1) & 0xff);
+        body += (char)((counts[symbol] - 1) >> 8);
+    }
+    size_of_table = body.size();
+
+    // The k-th state of a symbol, in table order, is reached from encoder
+    // states whose top bits are counts[symbol] + k.
+    std::vector<unsigned char> symbols = spread(counts);
+    std::vector<std::uint16_t> targets(ANS_TABLE_SIZE);
+    std::vector<std::uint32_t> filled(starts.begin(), starts.end() - 1);
+    for (std::size_t position = 0; position < ANS_TABLE_SIZE; ++position)
+        targets[filled[symbols[position]]++] = position;
+    std::vector<std::uint32_t> max_bits(ALPHABET_SIZE, 0);
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+        if (counts[symbol])
+            max_bits[symbol] = ANS_TABLE_LOG - (31 - __builtin_clz(counts[symbol]));
+    }
+
+    std::vector<std::uint32_t> chunks(text.size());
+    std::uint32_t x = ANS_TABLE_SIZE;
+    for (std::size_t i = text.size(); i-- > 0;) {
+        unsigned char symbol = text[i];
+        std::uint32_t bits = max_bits[symbol];
+        if ((x >> bits) < counts[symbol])
+            --bits;
+        chunks[i] = (x & ((1u << bits) - 1)) << 4 | bits;
+        x = ANS_TABLE_SIZE + targets[starts[symbol] + (x >> bits) - counts[symbol]];
+    }
+    bit_writer writer;
+    writer.reserve(text.size());
+    writer.write(x - ANS_TABLE_SIZE, ANS_TABLE_LOG);
+    for (std::uint32_t chunk : chunks)
+        writer.write(chunk >> 4, chunk & 0xf);
+    return body + writer.finish();
+}
+
+std::size_t ans_coder::decode(const char* body, std::size_t size, char* output, std::size_t size_of_output) {
+    std::size_t position = ALPHABET_SIZE / 8, total = 0;
+    if (size < position)
+        throw std::invalid_argument("file is corrupted");
+    std::vector<std::uint32_t> counts(ALPHABET_SIZE, 0);
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+        if (!(body[symbol / 8] & (1 << (symbol % 8))))
+            continue;
+        if (position + 2 > size)
+            throw std::invalid_argument("file is corrupted");
+        counts[symbol] = ((unsigned char)body[position] | (unsigned char)body[position + 1] << 8) + 1;
+        total += counts[symbol];
+        position += 2;
+    }
+    if (total != ANS_TABLE_SIZE)
+        throw std::invalid_argument("file is corrupted");
+
+    std::vector<unsigned char> symbols = spread(counts);
+    std::vector<state> states(ANS_TABLE_SIZE);
+    for (std::size_t i = 0; i < ANS_TABLE_SIZE; ++i) {
+        unsigned char symbol = symbols[i];
+        std::uint32_t x = counts[symbol]++;
+        states[i].symbol = symbol;
+        states[i].bits = ANS_TABLE_LOG - (31 - __builtin_clz(x));
+        states[i].next = (x << states[i].bits) - ANS_TABLE_SIZE;
+    }
+
+    bit_reader<> reader(body + position, size - position);
+    std::size_t total_bits = (size - position) * BYTE_SIZE;
+    std::size_t current = reader.read(ANS_TABLE_LOG);
+    for (std::size_t i = 0; i < size_of_output; ++i) {
+        const state& item = states[current];
+        output[i] = item.symbol;
+        reader.refill();
+        current = item.next + (reader.peek(item.bits + 1) >> 1);
+        reader.consume(item.bits);
+    }
+    if (reader.position() > total_bits)
+        throw std::invalid_argument("file is corrupted");
+    return position;
+}
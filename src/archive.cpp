@@ -0,0 +1,249 @@
+#include "archive.h"
+#include "checksum.h"
+#include "huffman.h"
+#include "mapped_file.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace huffman;
+
+namespace {
+    // Member names are relative paths that must stay inside the output directory.
+    bool is_valid_name(const std::string& name) {
+        if (name.empty() || name[0] == '/' || name.size() > UINT16_MAX)
+            return false;
+        std::size_t begin = 0;
+        while (begin <= name.size()) {
+            std::size_t end = std::min(name.find('/', begin), name.size());
+            if (name.compare(begin, end - begin, "..") == 0)
+                return false;
+            begin = end + 1;
+        }
+        return true;
+    }
+
+    void make_directories(const std::string& path) {
+        for (std::size_t separator = path.find('/', 1); separator != std::string::npos; separator = path.find('/', separator + 1)) {
+            if (::mkdir(path.substr(0, separator).c_str(), 0755) != 0 && errno != EEXIST)
+                throw std::runtime_error("cannot create directory");
+        }
+    }
+
+    template <typename T>
+    T read_value(const char*& current, const char* end) {
+        T value;
+        if (end - current < (std::ptrdiff_t)sizeof(T))
+            throw std::invalid_argument("file is corrupted");
+        std::memcpy(&value, current, sizeof(T));
+        current += sizeof(T);
+        return value;
+    }
+}
+
+std::string archive_encoder::encode_member(const char* data, std::size_t size, const encoder_options& options, archive_entry& entry, std::size_t& size_of_payload) {
+    std::string output;
+    entry.size_of_file = size;
+    entry.checksum = checksum::crc32(data, size);
+    std::vector<unsigned char> previous;
+    for (std::size_t offset = 0; offset < size; offset += options.block_size) {
+        block_header header;
+        std::size_t size_of_table;
+        std::string body = block_encoder::encode_block(data + offset, std::min(options.block_size, size - offset), options, header, size_of_table, previous);
+        block_encoder::write_block_header(output, header);
+        output += body;
+        size_of_payload += body.size() - size_of_table;
+        ++entry.block_count;
+    }
+    entry.packed_size = output.size();
+    return output;
+}
+
+void archive_encoder::write_directory(std::string& output, const std::vector<archive_entry>& entries, std::uint64_t directory_offset) {
+    for (const archive_entry& entry : entries) {
+        std::uint16_t name_size = entry.name.size();
+        output.append((const char*)&name_size, sizeof(name_size));
+        output += entry.name;
+        output.append((const char*)&entry.size_of_file, sizeof(entry.size_of_file));
+        output.append((const char*)&entry.offset, sizeof(entry.offset));
+        output.append((const char*)&entry.packed_size, sizeof(entry.packed_size));
+        output.append((const char*)&entry.block_count, sizeof(entry.block_count));
+        output.append((const char*)&entry.checksum, sizeof(entry.checksum));
+    }
+    std::uint64_t count = entries.size();
+    output.append((const char*)&directory_offset, sizeof(directory_offset));
+    output.append((const char*)&count, sizeof(count));
+    output.append(ARCHIVE_MAGIC, BLOCK_MAGIC_SIZE);
+}
+
+// Members are compressed in parallel a batch at a time and written in order,
+// so memory stays bounded by the batch and not by the number of files.
+void archive_encoder::encode(const std::vector<std::string>& input_filenames, const std::string& output_filename, const encoder_options& options) {
+    if (!options.block_size || options.block_size > MAX_BLOCK_SIZE)
+        throw std::invalid_argument("invalid block size");
+    // Appended members overwrite the old central directory, the members
+    // already in the archive stay where they are.
+    std::vector<archive_entry> entries;
+    std::uint64_t offset = 0;
+    bool appending = options.append && std::ifstream(output_filename, std::ios::binary).peek() != EOF;
+    if (appending) {
+        mapped_input existing(output_filename);
+        entries = archive_decoder::read_directory(existing.data(), existing.size());
+        std::memcpy(&offset, existing.data() + existing.size() - ARCHIVE_TRAILER_SIZE, sizeof(offset));
+    }
+    std::fstream output_file(output_filename, std::ios::binary | std::ios::in | std::ios::out | (appending ? std::ios::openmode() : std::ios::trunc));
+    if (!output_file.is_open())
+        throw std::invalid_argument("no file");
+    std::string output;
+    if (appending) {
+        output_file.seekp(offset);
+    }
+    else {
+        output.assign(ARCHIVE_MAGIC, BLOCK_MAGIC_SIZE);
+        output += (char)ARCHIVE_VERSION;
+        output += (char)0;
+        output_file.write(output.data(), output.size());
+        offset = ARCHIVE_HEADER_SIZE;
+    }
+    std::map<std::string, std::size_t> positions;
+    for (std::size_t i = 0; i < entries.size(); ++i)
+        positions[entries[i].name] = i;
+
+    std::size_t threads = std::max<std::size_t>(1, options.threads);
+    std::size_t size_of_file = 0, size_of_payload = 0, size_of_output = appending ? 0 : offset;
+    for (std::size_t first = 0; first < input_filenames.size(); first += ARCHIVE_BATCH_SIZE) {
+        std::size_t count = std::min(ARCHIVE_BATCH_SIZE, input_filenames.size() - first);
+        std::vector<archive_entry> batch(count);
+        std::vector<std::string> bodies(count);
+        std::vector<std::size_t> payloads(count, 0);
+        parallel_for(count, threads, [&](std::size_t i) {
+            batch[i].name = input_filenames[first + i];
+            if (!is_valid_name(batch[i].name))
+                throw std::invalid_argument("invalid member name");
+            mapped_input input(batch[i].name);
+            bodies[i] = encode_member(input.data(), input.size(), options, batch[i], payloads[i]);
+        });
+        for (std::size_t i = 0; i < count; ++i) {
+            batch[i].offset = offset;
+            output_file.write(bodies[i].data(), bodies[i].size());
+            offset += bodies[i].size();
+            size_of_output += bodies[i].size();
+            size_of_file += batch[i].size_of_file;
+            size_of_payload += payloads[i];
+            auto position = positions.find(batch[i].name);
+            if (position != positions.end()) {
+                entries[position->second] = batch[i];
+            }
+            else {
+                positions[batch[i].name] = entries.size();
+                entries.push_back(batch[i]);
+            }
+        }
+    }
+    output.clear();
+    write_directory(output, entries, offset);
+    output_file.write(output.data(), output.size());
+    output_file.close();
+    if (::truncate(output_filename.c_str(), offset + output.size()) != 0)
+        throw std::runtime_error("cannot write output file");
+    std::cout << size_of_file << std::endl << size_of_payload << std::endl << size_of_output + output.size() - size_of_payload << std::endl;
+}
+
+std::vector<archive_entry> archive_decoder::read_directory(const char* data, std::size_t size) {
+    if (size < ARCHIVE_HEADER_SIZE + ARCHIVE_TRAILER_SIZE || std::memcmp(data, ARCHIVE_MAGIC, BLOCK_MAGIC_SIZE) != 0
+            || std::memcmp(data + size - BLOCK_MAGIC_SIZE, ARCHIVE_MAGIC, BLOCK_MAGIC_SIZE) != 0)
+        throw std::invalid_argument("file is corrupted");
+    if ((unsigned char)data[BLOCK_MAGIC_SIZE] != ARCHIVE_VERSION || data[BLOCK_MAGIC_SIZE + 1] != 0)
+        throw std::invalid_argument("unsupported version");
+    const char* end = data + size - ARCHIVE_TRAILER_SIZE;
+    const char* current = end;
+    std::uint64_t directory_offset = read_value<std::uint64_t>(current, data + size);
+    std::uint64_t count = read_value<std::uint64_t>(current, data + size);
+    if (directory_offset < ARCHIVE_HEADER_SIZE || directory_offset > size - ARCHIVE_TRAILER_SIZE)
+        throw std::invalid_argument("file is corrupted");
+
+    std::vector<archive_entry> entries;
+    current = data + directory_offset;
+    for (std::uint64_t i = 0; i < count; ++i) {
+        archive_entry entry;
+        std::uint16_t name_size = read_value<std::uint16_t>(current, end);
+        if (end - current < name_size)
+            throw std::invalid_argument("file is corrupted");
+        entry.name.assign(current, name_size);
+        current += name_size;
+        entry.size_of_file = read_value<std::uint64_t>(current, end);
+        entry.offset = read_value<std::uint64_t>(current, end);
+        entry.packed_size = read_value<std::uint64_t>(current, end);
+        entry.block_count = read_value<std::uint32_t>(current, end);
+        entry.checksum = read_value<std::uint32_t>(current, end);
+        if (entry.offset < ARCHIVE_HEADER_SIZE || entry.offset > directory_offset || entry.packed_size > directory_offset - entry.offset)
+            throw std::invalid_argument("file is corrupted");
+        entries.push_back(entry);
+    }
+    if (current != end)
+        throw std::invalid_argument("file is corrupted");
+    return entries;
+}
+
+std::size_t archive_decoder::decode_member(const archive_entry& entry, const char* data, char* output) {
+    std::size_t position = entry.offset, end = entry.offset + entry.packed_size, output_offset = 0, size_of_tables = 0;
+    std::shared_ptr<const huffman_table> table;
+    for (std::uint32_t i = 0; i < entry.block_count; ++i) {
+        block_header header = block_decoder::read_block_header(data + position, end - position);
+        if (header.raw_size > entry.size_of_file - output_offset)
+            throw std::invalid_argument("file is corrupted");
+        size_of_tables += block_decoder::decode_block(header, data + position + BLOCK_HEADER_SIZE, output + output_offset, table);
+        position += BLOCK_HEADER_SIZE + header.packed_size;
+        output_offset += header.raw_size;
+    }
+    if (position != end || output_offset != entry.size_of_file || checksum::crc32(output, output_offset) != entry.checksum)
+        throw std::invalid_argument("file is corrupted");
+    return size_of_tables + entry.block_count * BLOCK_HEADER_SIZE;
+}
+
+void archive_decoder::list(const std::string& input_filename) {
+    mapped_input input(input_filename);
+    for (const archive_entry& entry : read_directory(input.data(), input.size()))
+        std::cout << entry.size_of_file << ' ' << entry.packed_size << ' ' << entry.name << std::endl;
+}
+
+// Extracts the named members, or all of them when `names` is empty, each on
+// its own worker and straight into a mapped output file.
+void archive_decoder::extract(const std::string& input_filename, const std::string& output_directory, const std::vector<std::string>& names, std::size_t threads) {
+    mapped_input input(input_filename);
+    std::vector<archive_entry> entries = read_directory(input.data(), input.size());
+    if (!names.empty()) {
+        std::vector<archive_entry> selected;
+        for (const std::string& name : names) {
+            auto entry = std::find_if(entries.begin(), entries.end(), [&](const archive_entry& e) { return e.name == name; });
+            if (entry == entries.end())
+                throw std::invalid_argument("no file");
+            selected.push_back(*entry);
+        }
+        entries.swap(selected);
+    }
+
+    std::vector<std::size_t> additional(entries.size());
+    parallel_for(entries.size(), std::max<std::size_t>(1, threads), [&](std::size_t i) {
+        if (!is_valid_name(entries[i].name))
+            throw std::invalid_argument("file is corrupted");
+        std::string filename = output_directory + "/" + entries[i].name;
+        make_directories(filename);
+        mapped_output output(filename, entries[i].size_of_file);
+        additional[i] = decode_member(entries[i], input.data(), output.data());
+        output.close();
+    });
+
+    std::size_t size_of_file = 0, size_of_payload = 0, additional_information = ARCHIVE_HEADER_SIZE + ARCHIVE_TRAILER_SIZE;
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        size_of_file += entries[i].size_of_file;
+        size_of_payload += entries[i].packed_size - additional[i];
+        additional_information += additional[i] + sizeof(std::uint16_t) + entries[i].name.size() + 3 * sizeof(std::uint64_t) + 2 * sizeof(std::uint32_t);
+    }
+    std::cout << size_of_payload << std::endl << size_of_file << std::endl << additional_information << std::endl;
+}
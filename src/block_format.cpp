@@ -0,0 +1,799 @@
+#include "block_format.h"
+#include "adaptive_huffman.h"
+#include "ans_coder.h"
+#include "bit_reader.h"
+#include "bit_writer.h"
+#include "block_splitter.h"
+#include "context_model.h"
+#include "decode_table.h"
+#include "digram_coder.h"
+#include "huffman.h"
+#include "mapped_file.h"
+#include "range_coder.h"
+#include "parallel_for.h"
+#include "transforms.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+using namespace huffman;
+
+void block_encoder::write_file_header(std::string& output, const file_header& header) {
+    output.append(BLOCK_MAGIC, BLOCK_MAGIC_SIZE);
+    output += (char)header.version;
+    output += (char)header.flags;
+    output.append((const char*)&header.block_size, sizeof(header.block_size));
+    output.append((const char*)&header.block_count, sizeof(header.block_count));
+    output.append((const char*)&header.size_of_file, sizeof(header.size_of_file));
+}
+
+void block_encoder::write_block_header(std::string& output, const block_header& header) {
+    output += (char)header.coder;
+    output += (char)header.transforms;
+    output.append((const char*)&header.raw_size, sizeof(header.raw_size));
+    output.append((const char*)&header.coded_size, sizeof(header.coded_size));
+    output.append((const char*)&header.packed_size, sizeof(header.packed_size));
+}
+
+huffman_table::huffman_table(const std::vector<unsigned char>& lengths, int escape)
+    : lengths(lengths), escape(escape), table(canonical_code::get_code_to_symbol(lengths), escape) {}
+
+// Folded-out symbols and the escape symbol itself are coded as the escape
+// code followed by the literal byte.
+std::vector<code_word> block_encoder::get_code_words(const block_plan& plan) {
+    std::vector<code_word> words = canonical_code::get_code_words(plan.lengths);
+    if (plan.escape != NO_ESCAPE) {
+        code_word escape_word = words[plan.escape];
+        for (const std::pair<const char, std::size_t>& symbol : plan.table) {
+            unsigned char index = symbol.first;
+            if (!plan.lengths[index] || index == plan.escape) {
+                words[index].bits = (escape_word.bits << BYTE_SIZE) | index;
+                words[index].length = escape_word.length + BYTE_SIZE;
+            }
+        }
+    }
+    return words;
+}
+
+block_plan block_encoder::plan_block(const char* data, std::size_t size, const encoder_options& options) {
+    block_plan plan;
+    plan.header.raw_size = size;
+    plan.text.assign(data, size);
+    plan.table = huffman_encoder::get_table(plan.text);
+    if (plan.table.size() <= 1) {
+        plan.header.coder = plan.table.empty() ? CODER_STORED : CODER_CONSTANT;
+        plan.header.coded_size = size;
+        return plan;
+    }
+    unsigned char filter = options.filter_blocks || options.auto_select ? delta_filter::choose(data, size) : 0;
+    if (filter) {
+        std::string filtered = delta_filter::encode(plan.text, filter);
+        std::map<char, std::size_t> filtered_table = huffman_encoder::get_table(filtered);
+        if (huffman_encoder::get_encoded_size(filtered_table, BLOCK_ENTRY_SIZE) < huffman_encoder::get_encoded_size(plan.table, BLOCK_ENTRY_SIZE)) {
+            plan.header.transforms |= TRANSFORM_DELTA;
+            plan.text.swap(filtered);
+            plan.table.swap(filtered_table);
+        }
+    }
+    // Matches cover runs as well, so run_length is not tried.
+    if (options.coder == CODER_LZ77 && !options.auto_select) {
+        plan.header.coder = CODER_LZ77;
+        plan.header.coded_size = plan.text.size();
+        plan.match_depth = options.match_depth;
+        return plan;
+    }
+    if (options.sort_blocks && plan.text.size() <= MAX_SORTED_SIZE) {
+        std::string sorted = burrows_wheeler::encode(plan.text);
+        move_to_front::encode(sorted);
+        std::map<char, std::size_t> sorted_table = huffman_encoder::get_table(sorted);
+        if (huffman_encoder::get_encoded_size(sorted_table, BLOCK_ENTRY_SIZE) < huffman_encoder::get_encoded_size(plan.table, BLOCK_ENTRY_SIZE)) {
+            plan.header.transforms |= TRANSFORM_BURROWS_WHEELER;
+            plan.text.swap(sorted);
+            plan.table.swap(sorted_table);
+        }
+    }
+    bool try_runs = true;
+    if (options.sample_decisions) {
+        std::string sample = get_sample(plan.text);
+        std::size_t sample_size = huffman_encoder::get_encoded_size(huffman_encoder::get_table(sample), BLOCK_ENTRY_SIZE);
+        try_runs = huffman_encoder::get_encoded_size(huffman_encoder::get_table(run_length::encode(sample)), BLOCK_ENTRY_SIZE) < sample_size;
+    }
+    if (try_runs) {
+        std::string runs = run_length::encode(plan.text);
+        std::map<char, std::size_t> runs_table = huffman_encoder::get_table(runs);
+        if (huffman_encoder::get_encoded_size(runs_table, BLOCK_ENTRY_SIZE) < huffman_encoder::get_encoded_size(plan.table, BLOCK_ENTRY_SIZE)) {
+            plan.header.transforms |= TRANSFORM_RUN_LENGTH;
+            plan.text.swap(runs);
+            plan.table.swap(runs_table);
+        }
+    }
+    plan.header.coded_size = plan.text.size();
+    unsigned char coder = options.auto_select ? choose_coder(plan.text, options) : options.coder;
+    plan.match_depth = options.match_depth;
+    // A sample can mislead the choice, so when the options also name a coder,
+    // as level 9 does, both are measured on the whole block and the smaller wins.
+    // A Huffman block's size depends on the previous table, so choose_table
+    // makes that comparison.
+    if (options.auto_select && options.coder != CODER_HUFFMAN && coder != options.coder) {
+        plan.body = encode_text(options.coder, plan, plan.size_of_table);
+        plan.body_coder = options.coder;
+        if (coder != CODER_HUFFMAN) {
+            std::size_t size_of_table = 0;
+            std::string body = encode_text(coder, plan, size_of_table);
+            if (body.size() <= plan.body.size()) {
+                plan.body.swap(body);
+                plan.size_of_table = size_of_table;
+                plan.body_coder = coder;
+            }
+            coder = plan.body_coder;
+        }
+    }
+    if (coder != CODER_HUFFMAN) {
+        plan.header.coder = coder;
+        return plan;
+    }
+
+    std::map<char, std::size_t> folded(plan.table);
+    char escape = 0;
+    if (options.escape_rare && huffman_encoder::fold_rare_symbols(folded, escape, BLOCK_ENTRY_SIZE))
+        plan.escape = (unsigned char)escape;
+    plan.lengths = canonical_code::get_lengths(folded, options.max_code_length);
+    return plan;
+}
+
+// Picks the cheapest of a fresh table, the previous block's table as is, and
+// the length changes against it; a block that would not shrink is stored.
+// Sizes are exact, so the bits are only written for the chosen variant, and a
+// body plan_block encoded with another coder replaces it only if smaller.
+void block_encoder::choose_table(block_plan& plan, std::vector<unsigned char>& previous) {
+    if (plan.header.coder != CODER_HUFFMAN)
+        return;
+    std::vector<code_word> words = get_code_words(plan);
+    std::size_t bits = 0;
+    for (const std::pair<const char, std::size_t>& symbol : plan.table)
+        bits += symbol.second * words[(unsigned char)symbol.first].length;
+    plan.table_bytes.assign(1, (char)(plan.escape != NO_ESCAPE ? TABLE_ESCAPE : 0));
+    if (plan.escape != NO_ESCAPE)
+        plan.table_bytes += (char)plan.escape;
+    canonical_code::write_lengths(plan.table_bytes, plan.lengths);
+    std::size_t best = plan.table_bytes.size() + (bits + BYTE_SIZE - 1) / BYTE_SIZE;
+
+    if (plan.escape == NO_ESCAPE && !previous.empty()) {
+        bool reusable = true;
+        for (const std::pair<const char, std::size_t>& symbol : plan.table)
+            reusable = reusable && previous[(unsigned char)symbol.first];
+        std::size_t reuse_bits = canonical_code::get_encoded_bits(plan.table, previous);
+        std::string delta;
+        for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+            if (plan.lengths[symbol] != previous[symbol])
+                delta += std::string(1, (char)symbol) + (char)plan.lengths[symbol];
+        }
+        if (reusable && 1 + (reuse_bits + BYTE_SIZE - 1) / BYTE_SIZE <= best) {
+            best = 1 + (reuse_bits + BYTE_SIZE - 1) / BYTE_SIZE;
+            plan.lengths = previous;
+            plan.table_bytes.assign(1, (char)TABLE_REUSE);
+        }
+        else if (delta.size() / 2 <= MAX_DELTA_CHANGES && 2 + delta.size() + (bits + BYTE_SIZE - 1) / BYTE_SIZE < best) {
+            best = 2 + delta.size() + (bits + BYTE_SIZE - 1) / BYTE_SIZE;
+            plan.table_bytes = std::string(1, (char)TABLE_DELTA) + (char)(delta.size() / 2) + delta;
+        }
+    }
+    if (!plan.body.empty() && plan.body.size() < best) {
+        plan.header.coder = plan.body_coder;
+        return;
+    }
+    plan.body.clear();
+    if (best >= plan.header.raw_size) {
+        plan.header.coder = CODER_STORED;
+        return;
+    }
+    plan.header.packed_size = best;
+    if (plan.escape == NO_ESCAPE)
+        previous = plan.lengths;
+    else
+        previous.clear();
+}
+
+std::string block_encoder::encode_plan(const block_plan& plan, const char* data, block_header& header, std::size_t& size_of_table) {
+    header = plan.header;
+    std::string body;
+    switch (header.coder) {
+    case CODER_CONSTANT:
+        body.assign(1, plan.text[0]);
+        size_of_table = 1;
+        break;
+    case CODER_HUFFMAN: {
+        std::vector<code_word> words = get_code_words(plan);
+        bit_writer writer;
+        writer.reserve(plan.text.size());
+        for (char symbol : plan.text)
+            writer.write(words[(unsigned char)symbol].bits, words[(unsigned char)symbol].length);
+        body = plan.table_bytes + writer.finish();
+        size_of_table = plan.table_bytes.size();
+        break;
+    }
+    default:
+        if (plan.body.empty())
+            body = encode_text(header.coder, plan, size_of_table);
+        else {
+            body = plan.body;
+            size_of_table = plan.size_of_table;
+        }
+        break;
+    }
+    // Incompressible data (already compressed or encrypted) is stored as is.
+    if (header.coder == CODER_STORED || body.size() >= header.raw_size) {
+        header.coder = CODER_STORED;
+        header.transforms = 0;
+        header.coded_size = header.raw_size;
+        body.assign(data, header.raw_size);
+        size_of_table = 0;
+    }
+    header.packed_size = body.size();
+    return body;
+}
+
+// The body of a block for a coder that needs nothing from the previous blocks.
+std::string block_encoder::encode_text(unsigned char coder, const block_plan& plan, std::size_t& size_of_table) {
+    switch (coder) {
+    case CODER_ADAPTIVE: {
+        adaptive_huffman model;
+        bit_writer writer;
+        writer.reserve(plan.text.size());
+        for (char symbol : plan.text)
+            model.encode(symbol, writer);
+        size_of_table = 0;
+        return writer.finish();
+    }
+    case CODER_CONTEXT:
+        return context_coder::encode(plan.text, size_of_table);
+    case CODER_DIGRAM:
+        return digram_coder::encode(plan.text, size_of_table);
+    case CODER_LZ77:
+        return lz77_coder::encode(plan.text, plan.match_depth, size_of_table);
+    case CODER_ANS:
+        return ans_coder::encode(plan.text, plan.table, size_of_table);
+    case CODER_RANGE:
+        return range_coder::encode(plan.text, size_of_table);
+    default:
+        size_of_table = 0;
+        return std::string();
+    }
+}
+
+std::string block_encoder::encode_block(const char* data, std::size_t size, const encoder_options& options, block_header& header, std::size_t& size_of_table, std::vector<unsigned char>& previous) {
+    block_plan plan = plan_block(data, size, options);
+    choose_table(plan, previous);
+    return encode_plan(plan, data, header, size_of_table);
+}
+
+std::string block_encoder::encode_block(const char* data, std::size_t size, const encoder_options& options, block_header& header, std::size_t& size_of_table) {
+    std::vector<unsigned char> previous;
+    return encode_block(data, size, options, header, size_of_table, previous);
+}
+
+// The middle of the block is the least likely to be a header or padding.
+std::string block_encoder::get_sample(const std::string& text) {
+    std::size_t length = std::min(text.size(), AUTO_SAMPLE_SIZE);
+    return text.substr((text.size() - length) / 2, length);
+}
+
+// A sample from the middle of the block is encoded with every coder, from the
+// fastest to the slowest, and scaled to the block. A slower coder has to save
+// AUTO_MIN_GAIN of the best size so far to be chosen.
+unsigned char block_encoder::choose_coder(const std::string& text, const encoder_options& options) {
+    std::string sample = get_sample(text);
+    std::size_t length = sample.size();
+    std::map<char, std::size_t> table = huffman_encoder::get_table(sample);
+    if (table.size() <= 1)
+        return CODER_HUFFMAN;
+    std::vector<unsigned char> lengths = canonical_code::get_lengths(table, options.max_code_length);
+    std::string table_bytes;
+    canonical_code::write_lengths(table_bytes, lengths);
+    double scale = (double)text.size() / length;
+    double best = (double)canonical_code::get_encoded_bits(table, lengths) / BYTE_SIZE * scale + table_bytes.size();
+    unsigned char chosen = CODER_HUFFMAN;
+    for (unsigned char coder : {CODER_ANS, CODER_DIGRAM, CODER_LZ77, CODER_CONTEXT, CODER_RANGE}) {
+        std::size_t size_of_table = 0;
+        std::string body;
+        if (coder == CODER_ANS)
+            body = ans_coder::encode(sample, table, size_of_table);
+        else if (coder == CODER_DIGRAM)
+            body = digram_coder::encode(sample, size_of_table);
+        else if (coder == CODER_LZ77)
+            body = lz77_coder::encode(sample, options.match_depth, size_of_table);
+        else if (coder == CODER_CONTEXT)
+            body = context_coder::encode(sample, size_of_table);
+        else
+            body = range_coder::encode(sample, size_of_table);
+        double size = (body.size() - size_of_table) * scale + size_of_table;
+        if (size < best * (1 - AUTO_MIN_GAIN)) {
+            best = size;
+            chosen = coder;
+        }
+    }
+    return chosen;
+}
+
+// Constant and stored blocks are chosen by the encoder itself.
+unsigned char block_encoder::get_coder(const std::string& name) {
+    for (unsigned char coder = 0; coder < sizeof(CODER_NAMES) / sizeof(CODER_NAMES[0]); ++coder) {
+        if (name == CODER_NAMES[coder] && coder != CODER_CONSTANT && coder != CODER_STORED)
+            return coder;
+    }
+    throw std::invalid_argument("unknown coder");
+}
+
+// Levels go from the fastest coding to the smallest output, all in the same
+// format. DEFAULT_LEVEL is what encoder_options gives with adaptive splitting.
+encoder_options block_encoder::get_level(std::size_t level) {
+    if (level < MIN_LEVEL || level > MAX_LEVEL)
+        throw std::invalid_argument("invalid level");
+    encoder_options options;
+    options.adaptive = level > 1;
+    if (level == 1) {
+        options.max_code_length = LOOKUP_BITS;
+        options.sample_decisions = true;
+    }
+    else if (level == 3)
+        options.coder = CODER_CONTEXT;
+    else if (level == 4 || level == 5)
+        options.coder = CODER_LZ77;
+    else if (level >= 8)
+        options.coder = CODER_RANGE;
+    options.filter_blocks = level >= 4;
+    if (level == 5 || level == 9)
+        options.match_depth = 4 * DEFAULT_MATCH_DEPTH;
+    if (level >= 6) {
+        options.sort_blocks = true;
+        options.adaptive = false;
+        options.block_size = level == 6 ? DEFAULT_BLOCK_SIZE : 4 * DEFAULT_BLOCK_SIZE;
+    }
+    options.auto_select = level == 9;
+    return options;
+}
+
+// The coder followed by the transforms in the order they are applied, e.g. "huffman+delta+run_length".
+std::string block_encoder::get_mode_name(const block_header& header) {
+    std::string name = header.coder < sizeof(CODER_NAMES) / sizeof(CODER_NAMES[0]) ? CODER_NAMES[header.coder] : "unknown";
+    if (header.transforms & TRANSFORM_DELTA)
+        name += "+delta";
+    if (header.transforms & TRANSFORM_BURROWS_WHEELER)
+        name += "+bwt";
+    if (header.transforms & TRANSFORM_RUN_LENGTH)
+        name += "+run_length";
+    return name;
+}
+
+// New data is appended as one more member (see read_blocks), the blocks
+// already in the file are not touched.
+std::size_t block_encoder::get_append_offset(const std::string& output_filename) {
+    std::ifstream output_file(output_filename, std::ios::binary);
+    if (!output_file.is_open() || output_file.peek() == EOF)
+        return 0;
+    if (!block_decoder::is_block_file(output_file))
+        throw std::invalid_argument("file is corrupted");
+    output_file.seekg(0, std::ios::end);
+    return output_file.tellg();
+}
+
+void block_encoder::encode(const std::string& input_filename, const std::string& output_filename, const encoder_options& options) {
+    if (!options.block_size || options.block_size > MAX_BLOCK_SIZE)
+        throw std::invalid_argument("invalid block size");
+    if (options.max_code_length < BYTE_SIZE || options.max_code_length > MAX_CODE_LENGTH)
+        throw std::invalid_argument("invalid code length limit");
+    if (options.shard_index >= options.shard_count)
+        throw std::invalid_argument("invalid shard");
+    std::ifstream input_file(input_filename, std::ios::binary);
+    if (!input_file.is_open())
+        throw std::invalid_argument("no file");
+    // Shard i of n is bytes [size * i / n, size * (i + 1) / n), so the shards
+    // of a file, compressed anywhere and concatenated, decode to the file.
+    input_file.seekg(0, std::ios::end);
+    std::size_t size_of_input = input_file.tellg();
+    std::size_t shard_begin = size_of_input * options.shard_index / options.shard_count;
+    std::size_t remaining = size_of_input * (options.shard_index + 1) / options.shard_count - shard_begin;
+    input_file.seekg(shard_begin);
+    std::size_t member_offset = options.append ? get_append_offset(output_filename) : 0;
+    std::fstream output_file(output_filename, std::ios::binary | std::ios::in | std::ios::out | (member_offset ? std::ios::openmode() : std::ios::trunc));
+    if (!output_file.is_open())
+        throw std::invalid_argument("no file");
+    output_file.seekp(member_offset);
+    file_header header;
+    header.block_size = options.block_size;
+    std::string output;
+    write_file_header(output, header);
+    output_file.write(output.data(), output.size());
+
+    std::size_t threads = std::max<std::size_t>(1, options.threads);
+    std::size_t size_of_payload = 0, additional_information = FILE_HEADER_SIZE;
+    std::string buffer(threads * options.block_size, '\0');
+    std::vector<unsigned char> previous;
+    std::map<std::string, std::size_t> modes;
+    while (remaining) {
+        input_file.read(&buffer[0], std::min(buffer.size(), remaining));
+        std::size_t size = input_file.gcount();
+        if (!size)
+            break;
+        remaining -= size;
+        std::vector<std::size_t> offsets(1, 0);
+        if (options.adaptive) {
+            for (std::size_t length : block_splitter::split(buffer.data(), size, options.block_size))
+                offsets.push_back(offsets.back() + length);
+        }
+        else {
+            for (std::size_t offset = options.block_size; offset < size; offset += options.block_size)
+                offsets.push_back(offset);
+            offsets.push_back(size);
+        }
+        std::size_t count = offsets.size() - 1;
+        std::vector<block_plan> plans(count);
+        std::vector<block_header> headers(count);
+        std::vector<std::string> bodies(count);
+        std::vector<std::size_t> tables(count);
+        parallel_for(count, threads, [&](std::size_t i) {
+            plans[i] = plan_block(buffer.data() + offsets[i], offsets[i + 1] - offsets[i], options);
+        });
+        for (block_plan& plan : plans)
+            choose_table(plan, previous);
+        parallel_for(count, threads, [&](std::size_t i) {
+            bodies[i] = encode_plan(plans[i], buffer.data() + offsets[i], headers[i], tables[i]);
+            plans[i] = block_plan();
+        });
+        for (std::size_t i = 0; i < count; ++i) {
+            output.clear();
+            write_block_header(output, headers[i]);
+            output_file.write(output.data(), output.size());
+            output_file.write(bodies[i].data(), bodies[i].size());
+            additional_information += BLOCK_HEADER_SIZE + tables[i];
+            size_of_payload += bodies[i].size() - tables[i];
+            ++modes[get_mode_name(headers[i])];
+        }
+        header.block_count += count;
+        header.size_of_file += size;
+    }
+    input_file.close();
+
+    output.clear();
+    write_file_header(output, header);
+    output_file.seekp(member_offset);
+    output_file.write(output.data(), output.size());
+    output_file.close();
+    std::cout << header.size_of_file << std::endl << size_of_payload << std::endl << additional_information << std::endl;
+    // With automatic selection the statistics also say what was chosen: a mode and its number of blocks per line.
+    if (options.auto_select) {
+        for (const std::pair<const std::string, std::size_t>& mode : modes)
+            std::cout << mode.first << ' ' << mode.second << std::endl;
+    }
+}
+
+bool block_decoder::is_block_file(std::ifstream& file) {
+    std::streampos position = file.tellg();
+    char magic[BLOCK_MAGIC_SIZE];
+    file.read(magic, BLOCK_MAGIC_SIZE);
+    bool result = file.gcount() == (std::streamsize)BLOCK_MAGIC_SIZE && std::memcmp(magic, BLOCK_MAGIC, BLOCK_MAGIC_SIZE) == 0;
+    file.clear();
+    file.seekg(position);
+    return result;
+}
+
+file_header block_decoder::read_file_header(const char* data, std::size_t size) {
+    if (size < FILE_HEADER_SIZE || std::memcmp(data, BLOCK_MAGIC, BLOCK_MAGIC_SIZE) != 0)
+        throw std::invalid_argument("file is corrupted");
+    file_header header;
+    const char* current = data + BLOCK_MAGIC_SIZE;
+    header.version = *current++;
+    header.flags = *current++;
+    std::memcpy(&header.block_size, current, sizeof(header.block_size));
+    current += sizeof(header.block_size);
+    std::memcpy(&header.block_count, current, sizeof(header.block_count));
+    current += sizeof(header.block_count);
+    std::memcpy(&header.size_of_file, current, sizeof(header.size_of_file));
+    if (header.version != BLOCK_VERSION || (header.flags & ~(FLAG_STREAM | FLAG_ADAPTIVE)))
+        throw std::invalid_argument("unsupported version");
+    return header;
+}
+
+block_header block_decoder::read_block_header(const char* data, std::size_t size) {
+    if (size < BLOCK_HEADER_SIZE)
+        throw std::invalid_argument("file is corrupted");
+    block_header header;
+    header.coder = data[0];
+    header.transforms = data[1];
+    std::memcpy(&header.raw_size, data + 2, sizeof(header.raw_size));
+    std::memcpy(&header.coded_size, data + 2 + sizeof(std::uint32_t), sizeof(header.coded_size));
+    std::memcpy(&header.packed_size, data + 2 + 2 * sizeof(std::uint32_t), sizeof(header.packed_size));
+    if (header.packed_size > size - BLOCK_HEADER_SIZE)
+        throw std::invalid_argument("file is corrupted");
+    return header;
+}
+
+// A file is one or more members, each a file header and its blocks, so that
+// independently compressed files can simply be concatenated. Streams do not
+// know their block count up front and end with a CODER_END frame instead.
+// `header` gets the totals over all members. Tables are resolved here, in
+// order, so blocks can then be decoded in any order.
+std::vector<block_decoder::block_entry> block_decoder::read_blocks(const char* data, std::size_t size, file_header& header) {
+    std::vector<block_entry> blocks;
+    std::size_t offset = 0, output_offset = 0;
+    header = read_file_header(data, size);
+    while (offset < size) {
+        file_header member = read_file_header(data + offset, size - offset);
+        offset += FILE_HEADER_SIZE;
+        if (member.flags & FLAG_ADAPTIVE) {
+            std::size_t first = blocks.size();
+            while (true) {
+                block_entry frame;
+                frame.header = read_frame_header(data + offset, size - offset);
+                offset += ADAPTIVE_FRAME_SIZE;
+                if (frame.header.coder == CODER_END)
+                    break;
+                frame.body_offset = offset;
+                frame.output_offset = output_offset;
+                offset += frame.header.packed_size;
+                output_offset += frame.header.raw_size;
+                blocks.push_back(frame);
+            }
+            if (blocks.size() > first)
+                blocks[first].frames = blocks.size() - first;
+            continue;
+        }
+        bool stream = member.flags & FLAG_STREAM;
+        std::size_t member_offset = output_offset;
+        std::shared_ptr<const huffman_table> table;
+        for (std::uint64_t i = 0; stream || i < member.block_count; ++i) {
+            block_entry block;
+            block.header = read_block_header(data + offset, size - offset);
+            if (stream && block.header.coder == CODER_END) {
+                offset += BLOCK_HEADER_SIZE;
+                break;
+            }
+            block.body_offset = offset + BLOCK_HEADER_SIZE;
+            block.output_offset = output_offset;
+            if (block.header.coder == CODER_HUFFMAN) {
+                block.size_of_table = read_table(data + block.body_offset, block.header.packed_size, table);
+                block.table = table;
+            }
+            offset = block.body_offset + block.header.packed_size;
+            output_offset += block.header.raw_size;
+            blocks.push_back(block);
+        }
+        if (!stream && output_offset - member_offset != member.size_of_file)
+            throw std::invalid_argument("file is corrupted");
+    }
+    header.block_count = blocks.size();
+    header.size_of_file = output_offset;
+    return blocks;
+}
+
+// An adaptive frame is its byte count and packed size, an empty one ends the
+// member. It comes back as a CODER_ADAPTIVE block, or CODER_END.
+block_header block_decoder::read_frame_header(const char* data, std::size_t size) {
+    if (size < ADAPTIVE_FRAME_SIZE)
+        throw std::invalid_argument("file is corrupted");
+    block_header header;
+    header.coder = CODER_ADAPTIVE;
+    std::memcpy(&header.raw_size, data, sizeof(header.raw_size));
+    std::memcpy(&header.packed_size, data + sizeof(header.raw_size), sizeof(header.packed_size));
+    header.coded_size = header.raw_size;
+    if (header.raw_size > MAX_BLOCK_SIZE || header.packed_size > size - ADAPTIVE_FRAME_SIZE || (header.raw_size == 0) != (header.packed_size == 0))
+        throw std::invalid_argument("file is corrupted");
+    if (header.raw_size == 0)
+        header.coder = CODER_END;
+    return header;
+}
+
+// Decodes `count` frames with one model, each into `output` at its offset
+// from the first one.
+void block_decoder::decode_frames(const char* data, const block_entry* frames, std::size_t count, char* output) {
+    adaptive_huffman model;
+    for (std::size_t i = 0; i < count; ++i) {
+        const block_entry& frame = frames[i];
+        bit_reader<> reader(data + frame.body_offset, frame.header.packed_size);
+        char* symbols = output + frame.output_offset - frames->output_offset;
+        for (std::size_t j = 0; j < frame.header.raw_size; ++j)
+            model.decode(reader, symbols[j]);
+        if (reader.position() > frame.header.packed_size * BYTE_SIZE)
+            throw std::invalid_argument("file is corrupted");
+    }
+}
+
+// `table` holds the previous Huffman block's table on entry and this block's
+// table on return; blocks that reuse it share the built decode table.
+std::size_t block_decoder::read_table(const char* body, std::size_t size, std::shared_ptr<const huffman_table>& table) {
+    if (!size)
+        throw std::invalid_argument("file is corrupted");
+    unsigned char flags = body[0];
+    if (flags == TABLE_REUSE || flags == TABLE_DELTA) {
+        if (!table || table->escape != NO_ESCAPE)
+            throw std::invalid_argument("file is corrupted");
+        if (flags == TABLE_REUSE)
+            return 1;
+        if (size < 2 || size - 2 < 2 * (std::size_t)(unsigned char)body[1])
+            throw std::invalid_argument("file is corrupted");
+        std::size_t count = (unsigned char)body[1];
+        std::vector<unsigned char> lengths = table->lengths;
+        for (std::size_t i = 0; i < count; ++i)
+            lengths[(unsigned char)body[2 + 2 * i]] = body[3 + 2 * i];
+        table = std::make_shared<const huffman_table>(lengths, NO_ESCAPE);
+        return 2 + 2 * count;
+    }
+    if (flags & ~TABLE_ESCAPE)
+        throw std::invalid_argument("file is corrupted");
+    std::size_t position = 1;
+    int escape = NO_ESCAPE;
+    if (flags & TABLE_ESCAPE) {
+        if (size < 2)
+            throw std::invalid_argument("file is corrupted");
+        escape = (unsigned char)body[position++];
+    }
+    std::vector<unsigned char> lengths;
+    position += canonical_code::read_lengths(body + position, size - position, lengths);
+    table = std::make_shared<const huffman_table>(lengths, escape);
+    return position;
+}
+
+void block_decoder::decode_huffman(const char* body, std::size_t size, char* output, std::size_t size_of_output, const huffman_table& table, std::size_t size_of_table) {
+    bit_reader<> reader(body + size_of_table, size - size_of_table);
+    std::size_t total_bits = (size - size_of_table) * BYTE_SIZE;
+    for (std::size_t i = 0; i < size_of_output; ++i) {
+        if (!table.table.decode(reader, output[i]) || reader.position() > total_bits)
+            throw std::invalid_argument("file is corrupted");
+    }
+}
+
+std::size_t block_decoder::decode_block(const block_header& header, const char* body, char* output, const huffman_table* table, std::size_t size_of_table) {
+    if (header.transforms & ~(TRANSFORM_RUN_LENGTH | TRANSFORM_BURROWS_WHEELER | TRANSFORM_DELTA))
+        throw std::invalid_argument("unsupported block transform");
+    // Each stage decodes into the buffer of the stage below it.
+    std::string coded, sorted, filtered;
+    char* symbols = output;
+    std::size_t size_of_filtered = header.raw_size;
+    if (header.transforms & TRANSFORM_DELTA) {
+        size_of_filtered += 1;
+        filtered.resize(size_of_filtered);
+        symbols = &filtered[0];
+    }
+    char* filter_input = symbols;
+    std::size_t size_of_sorted = size_of_filtered;
+    if (header.transforms & TRANSFORM_BURROWS_WHEELER) {
+        size_of_sorted += BWT_INDEX_SIZE;
+        sorted.resize(size_of_sorted);
+        symbols = &sorted[0];
+    }
+    char* sort_input = symbols;
+    if (header.transforms & TRANSFORM_RUN_LENGTH) {
+        coded.resize(header.coded_size);
+        symbols = &coded[0];
+    }
+    else if (header.coded_size != size_of_sorted) {
+        throw std::invalid_argument("file is corrupted");
+    }
+
+    switch (header.coder) {
+    case CODER_CONSTANT:
+        if (header.packed_size != 1)
+            throw std::invalid_argument("file is corrupted");
+        std::memset(symbols, body[0], header.coded_size);
+        size_of_table = 1;
+        break;
+    case CODER_STORED:
+        if (header.packed_size != header.coded_size)
+            throw std::invalid_argument("file is corrupted");
+        std::memcpy(symbols, body, header.coded_size);
+        size_of_table = 0;
+        break;
+    case CODER_ADAPTIVE: {
+        adaptive_huffman model;
+        bit_reader<> reader(body, header.packed_size);
+        for (std::size_t i = 0; i < header.coded_size; ++i) {
+            model.decode(reader, symbols[i]);
+            if (reader.position() > header.packed_size * BYTE_SIZE)
+                throw std::invalid_argument("file is corrupted");
+        }
+        size_of_table = 0;
+        break;
+    }
+    case CODER_CONTEXT:
+        size_of_table = context_coder::decode(body, header.packed_size, symbols, header.coded_size);
+        break;
+    case CODER_DIGRAM:
+        size_of_table = digram_coder::decode(body, header.packed_size, symbols, header.coded_size);
+        break;
+    case CODER_LZ77:
+        size_of_table = lz77_coder::decode(body, header.packed_size, symbols, header.coded_size);
+        break;
+    case CODER_ANS:
+        size_of_table = ans_coder::decode(body, header.packed_size, symbols, header.coded_size);
+        break;
+    case CODER_RANGE:
+        size_of_table = range_coder::decode(body, header.packed_size, symbols, header.coded_size);
+        break;
+    case CODER_HUFFMAN:
+        if (!table)
+            throw std::invalid_argument("file is corrupted");
+        decode_huffman(body, header.packed_size, symbols, header.coded_size, *table, size_of_table);
+        break;
+    default:
+        throw std::invalid_argument("unsupported block coder");
+    }
+
+    if (header.transforms & TRANSFORM_RUN_LENGTH)
+        run_length::decode(coded, sort_input, size_of_sorted);
+    if (header.transforms & TRANSFORM_BURROWS_WHEELER) {
+        move_to_front::decode(sorted);
+        burrows_wheeler::decode(sorted, filter_input, size_of_filtered);
+    }
+    if (header.transforms & TRANSFORM_DELTA)
+        delta_filter::decode(filtered, output, header.raw_size);
+    return size_of_table;
+}
+
+std::size_t block_decoder::decode_block(const block_header& header, const char* body, char* output, std::shared_ptr<const huffman_table>& table) {
+    std::size_t size_of_table = 0;
+    if (header.coder == CODER_HUFFMAN)
+        size_of_table = read_table(body, header.packed_size, table);
+    return decode_block(header, body, output, table.get(), size_of_table);
+}
+
+void block_decoder::decode(const std::string& input_filename, const std::string& output_filename, std::size_t threads) {
+    mapped_input input(input_filename);
+    file_header header;
+    std::vector<block_entry> blocks = read_blocks(input.data(), input.size(), header);
+    mapped_output output(output_filename, header.size_of_file);
+    // The frames of an adaptive member are one job.
+    std::vector<std::size_t> jobs;
+    for (std::size_t i = 0; i < blocks.size(); i += std::max<std::size_t>(1, blocks[i].frames))
+        jobs.push_back(i);
+    std::vector<std::size_t> tables(blocks.size());
+    parallel_for(jobs.size(), std::max<std::size_t>(1, threads), [&](std::size_t job) {
+        const block_entry& block = blocks[jobs[job]];
+        if (block.frames)
+            decode_frames(input.data(), &block, block.frames, output.data() + block.output_offset);
+        else
+            tables[jobs[job]] = decode_block(block.header, input.data() + block.body_offset, output.data() + block.output_offset, block.table.get(), block.size_of_table);
+    });
+    output.close();
+
+    std::size_t size_of_payload = 0;
+    for (std::size_t i = 0; i < blocks.size(); ++i)
+        size_of_payload += blocks[i].header.packed_size - tables[i];
+    std::cout << size_of_payload << std::endl << header.size_of_file << std::endl << input.size() - size_of_payload << std::endl;
+}
+
+void block_decoder::decode_range(const std::string& input_filename, const std::string& output_filename, std::size_t begin, std::size_t end) {
+    mapped_input input(input_filename);
+    file_header header;
+    std::vector<block_entry> blocks = read_blocks(input.data(), input.size(), header);
+    end = std::min<std::size_t>(end, header.size_of_file);
+    if (begin > end)
+        throw std::invalid_argument("invalid range");
+    mapped_output output(output_filename, end - begin);
+    std::size_t size_of_packed = 0;
+    // Frames of an adaptive member can only be decoded from its first one, so
+    // the member is decoded up to the end of the range.
+    for (std::size_t i = 0; i < blocks.size(); i += std::max<std::size_t>(1, blocks[i].frames)) {
+        const block_entry& block = blocks[i];
+        std::size_t count = std::max<std::size_t>(1, block.frames);
+        std::size_t block_end = blocks[i + count - 1].output_offset + blocks[i + count - 1].header.raw_size;
+        if (block_end <= begin || block.output_offset >= end)
+            continue;
+        std::string text(block_end - block.output_offset, '\0');
+        if (block.frames) {
+            while (count > 1 && blocks[i + count - 1].output_offset >= end)
+                --count;
+            decode_frames(input.data(), &block, count, &text[0]);
+            for (std::size_t j = i; j < i + count; ++j)
+                size_of_packed += ADAPTIVE_FRAME_SIZE + blocks[j].header.packed_size;
+        }
+        else {
+            decode_block(block.header, input.data() + block.body_offset, &text[0], block.table.get(), block.size_of_table);
+            size_of_packed += BLOCK_HEADER_SIZE + block.header.packed_size;
+        }
+        std::size_t from = std::max(begin, block.output_offset), to = std::min(end, block_end);
+        std::memcpy(output.data() + from - begin, text.data() + from - block.output_offset, to - from);
+    }
+    output.close();
+    std::cout << size_of_packed << std::endl << end - begin << std::endl << FILE_HEADER_SIZE << std::endl;
+}
@@ -0,0 +1,64 @@
+#include "block_splitter.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace huffman;
+
+// Four interleaved tables, so that runs of the same byte do not serialize on
+// one counter.
+void block_splitter::count(const char* data, std::size_t size, histogram& counts) {
+    std::uint32_t partial[4][256] = {};
+    const unsigned char* bytes = (const unsigned char*)data;
+    std::size_t i = 0;
+    for (; i + 4 <= size; i += 4) {
+        ++partial[0][bytes[i]];
+        ++partial[1][bytes[i + 1]];
+        ++partial[2][bytes[i + 2]];
+        ++partial[3][bytes[i + 3]];
+    }
+    for (; i < size; ++i)
+        ++partial[0][bytes[i]];
+    for (std::size_t symbol = 0; symbol < 256; ++symbol)
+        counts[symbol] = partial[0][symbol] + partial[1][symbol] + partial[2][symbol] + partial[3][symbol];
+}
+
+// Order-0 entropy of the histogram in bits plus one table entry per present symbol.
+double block_splitter::get_cost(const histogram& counts) {
+    double total = 0, bits = 0;
+    for (std::uint32_t count : counts) {
+        if (count) {
+            total += count;
+            bits += 8 - count * std::log2((double)count);
+        }
+    }
+    return total ? bits + total * std::log2(total) : 0;
+}
+
+std::vector<std::size_t> block_splitter::split(const char* data, std::size_t size, std::size_t max_block_size) {
+    std::vector<std::size_t> sizes;
+    histogram current = {}, window, merged;
+    double current_cost = 0;
+    std::size_t current_size = 0;
+    std::size_t step = std::min(SPLIT_WINDOW, max_block_size);
+    for (std::size_t offset = 0; offset < size; offset += step) {
+        std::size_t length = std::min(step, size - offset);
+        count(data + offset, length, window);
+        for (std::size_t symbol = 0; symbol < 256; ++symbol)
+            merged[symbol] = current[symbol] + window[symbol];
+        double merged_cost = get_cost(merged);
+        if (current_size && (current_size + length > max_block_size || current_cost + get_cost(window) + SPLIT_OVERHEAD_BITS < merged_cost)) {
+            sizes.push_back(current_size);
+            current = window;
+            current_cost = get_cost(window);
+            current_size = length;
+        }
+        else {
+            current = merged;
+            current_cost = merged_cost;
+            current_size += length;
+        }
+    }
+    if (current_size)
+        sizes.push_back(current_size);
+    return sizes;
+}
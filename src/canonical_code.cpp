@@ -0,0 +1,148 @@
+#include "canonical_code.h"
+#include "huffman.h"
+#include <algorithm>
+#include <bitset>
+#include <functional>
+#include <queue>
+#include <stdexcept>
+
+using namespace huffman;
+
+// Code lengths of the Huffman tree for the table. While the longest code is
+// above max_length, the frequencies are halved and the tree is rebuilt, which
+// flattens the tree until it fits.
+std::vector<unsigned char> canonical_code::get_lengths(const std::map<char, std::size_t>& table, std::size_t max_length) {
+    std::vector<unsigned char> lengths(ALPHABET_SIZE, 0);
+    if (table.size() == 1) {
+        lengths[(unsigned char)table.begin()->first] = 1;
+        return lengths;
+    }
+    std::map<char, std::size_t> scaled(table);
+    while (true) {
+        std::map<char, std::string> codes = huffman_tree(scaled).get_symbol_to_code();
+        std::size_t longest = 0;
+        for (const std::pair<const char, std::string>& code : codes)
+            longest = std::max(longest, code.second.size());
+        if (longest <= max_length) {
+            for (const std::pair<const char, std::string>& code : codes)
+                lengths[(unsigned char)code.first] = code.second.size();
+            return lengths;
+        }
+        for (std::pair<const char, std::size_t>& symbol : scaled)
+            symbol.second = (symbol.second + 1) / 2;
+    }
+}
+
+// The same for an alphabet of any size, symbols being indices into counts.
+std::vector<unsigned char> canonical_code::get_lengths(const std::vector<std::size_t>& counts, std::size_t max_length) {
+    std::vector<unsigned char> lengths(counts.size(), 0);
+    std::vector<std::size_t> scaled(counts);
+    while (true) {
+        typedef std::pair<std::size_t, std::size_t> item;
+        std::priority_queue<item, std::vector<item>, std::greater<item>> queue;
+        std::vector<std::size_t> parents;
+        for (std::size_t symbol = 0; symbol < scaled.size(); ++symbol) {
+            if (scaled[symbol]) {
+                queue.emplace(scaled[symbol], parents.size());
+                parents.push_back(symbol);
+            }
+        }
+        std::size_t leaves = parents.size();
+        if (leaves == 1)
+            lengths[parents[0]] = 1;
+        if (leaves <= 1)
+            return lengths;
+        std::vector<std::size_t> symbols(parents);
+        while (queue.size() > 1) {
+            item left = queue.top();
+            queue.pop();
+            item right = queue.top();
+            queue.pop();
+            parents[left.second] = parents[right.second] = parents.size();
+            queue.emplace(left.first + right.first, parents.size());
+            parents.push_back(0);
+        }
+        // Internal nodes are created after their children, so depths are
+        // known when walking from the root down.
+        std::vector<std::size_t> depths(parents.size(), 0);
+        std::size_t longest = 0;
+        for (std::size_t node = parents.size() - 1; node-- > 0;) {
+            depths[node] = depths[parents[node]] + 1;
+            longest = std::max(longest, depths[node]);
+        }
+        if (longest <= max_length) {
+            for (std::size_t leaf = 0; leaf < leaves; ++leaf)
+                lengths[symbols[leaf]] = depths[leaf];
+            return lengths;
+        }
+        for (std::size_t& count : scaled)
+            count = (count + 1) / 2;
+    }
+}
+
+std::vector<code_word> canonical_code::get_code_words(const std::vector<unsigned char>& lengths) {
+    std::vector<std::pair<unsigned char, std::size_t>> order;
+    for (std::size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+        if (lengths[symbol] > 32)
+            throw std::invalid_argument("file is corrupted");
+        if (lengths[symbol])
+            order.emplace_back(lengths[symbol], symbol);
+    }
+    std::sort(order.begin(), order.end());
+    std::vector<code_word> words(lengths.size());
+    std::uint64_t code = 0;
+    unsigned char previous = order.empty() ? 0 : order[0].first;
+    for (const std::pair<unsigned char, std::size_t>& item : order) {
+        code <<= item.first - previous;
+        if (code >> item.first)
+            throw std::invalid_argument("file is corrupted");
+        words[item.second].bits = code++;
+        words[item.second].length = item.first;
+        previous = item.first;
+    }
+    return words;
+}
+
+std::map<std::string, char> canonical_code::get_code_to_symbol(const std::vector<unsigned char>& lengths) {
+    std::vector<code_word> words = get_code_words(lengths);
+    std::map<std::string, char> codes;
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+        if (words[symbol].length)
+            codes[std::bitset<32>(words[symbol].bits).to_string().substr(32 - words[symbol].length)] = (char)symbol;
+    }
+    return codes;
+}
+
+std::size_t canonical_code::get_encoded_bits(const std::map<char, std::size_t>& table, const std::vector<unsigned char>& lengths) {
+    std::size_t bits = 0;
+    for (const std::pair<const char, std::size_t>& symbol : table)
+        bits += symbol.second * lengths[(unsigned char)symbol.first];
+    return bits;
+}
+
+// A presence bitmap of the alphabet followed by one length byte per present symbol.
+void canonical_code::write_lengths(std::string& output, const std::vector<unsigned char>& lengths) {
+    std::string bitmap(ALPHABET_SIZE / 8, '\0'), present;
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+        if (lengths[symbol]) {
+            bitmap[symbol / 8] |= 1 << (symbol % 8);
+            present += (char)lengths[symbol];
+        }
+    }
+    output += bitmap + present;
+}
+
+std::size_t canonical_code::read_lengths(const char* data, std::size_t size, std::vector<unsigned char>& lengths) {
+    std::size_t position = ALPHABET_SIZE / 8;
+    if (size < position)
+        throw std::invalid_argument("file is corrupted");
+    lengths.assign(ALPHABET_SIZE, 0);
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+        if (!(data[symbol / 8] & (1 << (symbol % 8))))
+            continue;
+        if (position >= size || !data[position])
+            throw std::invalid_argument("file is corrupted");
+        lengths[symbol] = data[position++];
+    }
+    return position;
+}
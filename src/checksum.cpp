@@ -0,0 +1,25 @@
+#include "checksum.h"
+#include <array>
+
+using namespace huffman;
+
+namespace {
+    std::array<std::uint32_t, 256> make_crc_table() {
+        std::array<std::uint32_t, 256> table;
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t value = i;
+            for (int bit = 0; bit < 8; ++bit)
+                value = (value >> 1) ^ (value & 1 ? 0xedb88320u : 0);
+            table[i] = value;
+        }
+        return table;
+    }
+}
+
+std::uint32_t checksum::crc32(const char* data, std::size_t size, std::uint32_t crc) {
+    static const std::array<std::uint32_t, 256> table = make_crc_table();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
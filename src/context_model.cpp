@@ -0,0 +1,196 @@
+#include "context_model.h"
+#include "bit_reader.h"
+#include "bit_writer.h"
+#include "huffman.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace huffman;
+
+std::size_t context_coder::get_index_bits(std::size_t count) {
+    std::size_t bits = 0;
+    while ((std::size_t(1) << bits) < count)
+        ++bits;
+    return bits;
+}
+
+// Seeds `count` clusters with the most frequent contexts and refines them a
+// few times, k-means style: each context moves to the cluster whose
+// distribution codes it in the fewest bits. Returns the estimated size in bits.
+double context_coder::assign(const std::vector<histogram>& contexts, std::size_t count, std::vector<unsigned char>& clusters) {
+    std::vector<std::pair<std::uint64_t, std::size_t>> order;
+    for (std::size_t context = 0; context < ALPHABET_SIZE; ++context) {
+        std::uint64_t total = 0;
+        for (std::uint32_t value : contexts[context])
+            total += value;
+        if (total)
+            order.emplace_back(total, context);
+    }
+    std::sort(order.rbegin(), order.rend());
+    count = std::min(count, order.size());
+    std::vector<histogram> sums(count);
+    for (std::size_t i = 0; i < count; ++i)
+        sums[i] = contexts[order[i].second];
+
+    clusters.assign(ALPHABET_SIZE, 0);
+    std::size_t rounds = count > 1 ? 3 : 1;
+    for (std::size_t round = 0; round < rounds; ++round) {
+        std::vector<std::array<double, ALPHABET_SIZE>> costs(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            double total = 0;
+            for (std::uint32_t value : sums[i])
+                total += value;
+            for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol)
+                costs[i][symbol] = -std::log2((sums[i][symbol] + 0.5) / (total + ALPHABET_SIZE / 2));
+        }
+        for (const std::pair<std::uint64_t, std::size_t>& context : order) {
+            double best = 0;
+            for (std::size_t i = 0; i < count; ++i) {
+                double bits = 0;
+                for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol)
+                    bits += contexts[context.second][symbol] * costs[i][symbol];
+                if (i == 0 || bits < best) {
+                    best = bits;
+                    clusters[context.second] = i;
+                }
+            }
+        }
+        sums.assign(count, histogram());
+        for (const std::pair<std::uint64_t, std::size_t>& context : order) {
+            for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol)
+                sums[clusters[context.second]][symbol] += contexts[context.second][symbol];
+        }
+    }
+
+    double bits = ALPHABET_SIZE * get_index_bits(count);
+    for (const histogram& sum : sums)
+        bits += block_splitter::get_cost(sum) + CONTEXT_TABLE_OVERHEAD_BITS;
+    return bits;
+}
+
+std::vector<unsigned char> context_coder::get_clusters(const std::vector<histogram>& contexts, std::size_t& count) {
+    std::vector<unsigned char> best_clusters, clusters;
+    double best = 0;
+    for (std::size_t candidate = 1; candidate <= MAX_CONTEXT_TABLES; candidate *= 2) {
+        double bits = assign(contexts, candidate, clusters);
+        if (candidate == 1 || bits < best) {
+            best = bits;
+            best_clusters = clusters;
+        }
+    }
+    // Clusters that ended up empty are dropped and the rest renumbered.
+    std::vector<int> renumber(MAX_CONTEXT_TABLES, -1);
+    std::vector<bool> used(MAX_CONTEXT_TABLES, false);
+    for (std::size_t context = 0; context < ALPHABET_SIZE; ++context) {
+        std::uint64_t total = 0;
+        for (std::uint32_t value : contexts[context])
+            total += value;
+        if (total)
+            used[best_clusters[context]] = true;
+    }
+    count = 0;
+    for (std::size_t i = 0; i < MAX_CONTEXT_TABLES; ++i) {
+        if (used[i])
+            renumber[i] = count++;
+    }
+    count = std::max<std::size_t>(count, 1);
+    for (unsigned char& cluster : best_clusters)
+        cluster = renumber[cluster] < 0 ? 0 : renumber[cluster];
+    return best_clusters;
+}
+
+std::string context_coder::encode(const std::string& text, std::size_t& size_of_table) {
+    std::vector<histogram> contexts(ALPHABET_SIZE, histogram());
+    unsigned char previous = 0;
+    for (char symbol : text) {
+        ++contexts[previous][(unsigned char)symbol];
+        previous = symbol;
+    }
+    std::size_t count;
+    std::vector<unsigned char> clusters = get_clusters(contexts, count);
+    std::vector<std::map<char, std::size_t>> tables(count);
+    for (std::size_t context = 0; context < ALPHABET_SIZE; ++context) {
+        for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+            if (contexts[context][symbol])
+                tables[clusters[context]][(char)symbol] += contexts[context][symbol];
+        }
+    }
+
+    std::string body(1, (char)count);
+    bit_writer map_writer;
+    for (unsigned char cluster : clusters)
+        map_writer.write(cluster, get_index_bits(count));
+    body += map_writer.finish();
+    std::vector<std::vector<code_word>> words(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        std::vector<unsigned char> lengths(ALPHABET_SIZE, 0);
+        if (!tables[i].empty())
+            lengths = canonical_code::get_lengths(tables[i], CONTEXT_CODE_LENGTH);
+        canonical_code::write_lengths(body, lengths);
+        words[i] = canonical_code::get_code_words(lengths);
+    }
+    size_of_table = body.size();
+
+    bit_writer writer;
+    writer.reserve(text.size());
+    previous = 0;
+    for (char symbol : text) {
+        const code_word& word = words[clusters[previous]][(unsigned char)symbol];
+        writer.write(word.bits, word.length);
+        previous = symbol;
+    }
+    return body + writer.finish();
+}
+
+std::size_t context_coder::decode(const char* body, std::size_t size, char* output, std::size_t size_of_output) {
+    if (!size || !body[0] || (unsigned char)body[0] > MAX_CONTEXT_TABLES)
+        throw std::invalid_argument("file is corrupted");
+    std::size_t count = (unsigned char)body[0], index_bits = get_index_bits(count);
+    std::size_t position = 1 + (ALPHABET_SIZE * index_bits + BYTE_SIZE - 1) / BYTE_SIZE;
+    if (position > size)
+        throw std::invalid_argument("file is corrupted");
+    std::vector<unsigned char> clusters(ALPHABET_SIZE, 0);
+    if (index_bits) {
+        bit_reader<> map_reader(body + 1, position - 1);
+        for (unsigned char& cluster : clusters) {
+            cluster = map_reader.read(index_bits);
+            if (cluster >= count)
+                throw std::invalid_argument("file is corrupted");
+        }
+    }
+
+    // (length << 8 | symbol) for every CONTEXT_CODE_LENGTH-bit prefix, 0 for unused codes.
+    std::vector<std::uint16_t> lookup(count << CONTEXT_CODE_LENGTH, 0);
+    for (std::size_t i = 0; i < count; ++i) {
+        std::vector<unsigned char> lengths;
+        position += canonical_code::read_lengths(body + position, size - position, lengths);
+        std::vector<code_word> words = canonical_code::get_code_words(lengths);
+        for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+            std::size_t length = words[symbol].length;
+            if (!length)
+                continue;
+            if (length > CONTEXT_CODE_LENGTH)
+                throw std::invalid_argument("file is corrupted");
+            std::size_t first = (i << CONTEXT_CODE_LENGTH) | (words[symbol].bits << (CONTEXT_CODE_LENGTH - length));
+            std::fill(lookup.begin() + first, lookup.begin() + first + (std::size_t(1) << (CONTEXT_CODE_LENGTH - length)), (std::uint16_t)(length << 8 | symbol));
+        }
+    }
+
+    bit_reader<> reader(body + position, size - position);
+    std::size_t total_bits = (size - position) * BYTE_SIZE;
+    const std::uint16_t* tables = lookup.data();
+    unsigned char previous = 0;
+    for (std::size_t i = 0; i < size_of_output; ++i) {
+        reader.refill();
+        std::uint16_t entry = tables[(std::size_t(clusters[previous]) << CONTEXT_CODE_LENGTH) | reader.peek(CONTEXT_CODE_LENGTH)];
+        if (!entry)
+            throw std::invalid_argument("file is corrupted");
+        reader.consume(entry >> 8);
+        previous = entry;
+        output[i] = previous;
+    }
+    if (reader.position() > total_bits)
+        throw std::invalid_argument("file is corrupted");
+    return position;
+}
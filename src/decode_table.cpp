@@ -0,0 +1,65 @@
+#include "decode_table.h"
+#include "canonical_code.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace huffman;
+
+decode_table::decode_table(const std::map<std::string, char>& codes, int escape) : escape(escape), lookup(1 << LOOKUP_BITS) {
+    bool has_escape = escape == NO_ESCAPE;
+    for (const std::pair<const std::string, char>& code : codes) {
+        has_escape |= (unsigned char)code.second == escape;
+        if (code.first.size() <= LOOKUP_BITS) {
+            std::size_t prefix = std::stoul(code.first, nullptr, 2) << (LOOKUP_BITS - code.first.size());
+            for (std::size_t i = 0; i < (std::size_t(1) << (LOOKUP_BITS - code.first.size())); ++i) {
+                lookup[prefix + i].symbol = code.second;
+                lookup[prefix + i].length = code.first.size();
+            }
+            continue;
+        }
+        std::size_t prefix = std::stoul(code.first.substr(0, LOOKUP_BITS), nullptr, 2);
+        if (lookup[prefix].node == INVALID) {
+            lookup[prefix].node = nodes.size();
+            nodes.emplace_back();
+        }
+        std::size_t current = lookup[prefix].node;
+        for (std::size_t i = LOOKUP_BITS; i < code.first.size(); ++i) {
+            std::size_t bit = code.first[i] - '0';
+            if (nodes[current].child[bit] == INVALID) {
+                nodes[current].child[bit] = nodes.size();
+                nodes.emplace_back();
+            }
+            current = nodes[current].child[bit];
+        }
+        nodes[current].symbol = code.second;
+    }
+    if (!has_escape)
+        throw std::invalid_argument("file is corrupted");
+}
+
+canonical_table::canonical_table(const std::vector<unsigned char>& lengths, std::size_t max_length)
+    : max_length(std::max(max_length, LOOKUP_BITS)), lookup(1 << LOOKUP_BITS, 0),
+      first_code(this->max_length + 1, 0), first_index(this->max_length + 1, 0), counts(this->max_length + 1, 0) {
+    std::vector<code_word> words = canonical_code::get_code_words(lengths);
+    std::vector<std::pair<unsigned char, std::uint32_t>> order;
+    for (std::size_t symbol = 0; symbol < lengths.size(); ++symbol) {
+        std::size_t length = lengths[symbol];
+        if (!length)
+            continue;
+        if (length > max_length)
+            throw std::invalid_argument("file is corrupted");
+        order.emplace_back(length, symbol);
+        if (length <= LOOKUP_BITS) {
+            std::size_t first = words[symbol].bits << (LOOKUP_BITS - length);
+            std::fill(lookup.begin() + first, lookup.begin() + first + (std::size_t(1) << (LOOKUP_BITS - length)), (std::uint32_t)(symbol << 8 | length));
+        }
+    }
+    std::sort(order.begin(), order.end());
+    for (std::size_t i = order.size(); i-- > 0;) {
+        first_code[order[i].first] = words[order[i].second].bits;
+        first_index[order[i].first] = i;
+        ++counts[order[i].first];
+    }
+    for (const std::pair<unsigned char, std::uint32_t>& item : order)
+        symbols.push_back(item.second);
+}
@@ -0,0 +1,125 @@
+#include "dictionary.h"
+#include "bit_writer.h"
+#include "checksum.h"
+#include "huffman.h"
+#include "mapped_file.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+using namespace huffman;
+
+// Bytes missing from the corpus still get (long) codes, so that messages
+// with unseen bytes stay encodable.
+dictionary dictionary_trainer::train(const std::vector<std::string>& input_filenames, std::size_t max_length) {
+    if (max_length < BYTE_SIZE || max_length > MAX_CODE_LENGTH)
+        throw std::invalid_argument("invalid code length limit");
+    std::map<char, std::size_t> table;
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol)
+        table[(char)symbol] = 1;
+    for (const std::string& filename : input_filenames) {
+        mapped_input input(filename);
+        for (std::size_t i = 0; i < input.size(); ++i)
+            ++table[input.data()[i]];
+    }
+    return make_dictionary(canonical_code::get_lengths(table, max_length));
+}
+
+dictionary dictionary_trainer::make_dictionary(const std::vector<unsigned char>& lengths) {
+    dictionary shared;
+    shared.lengths = lengths;
+    shared.words = canonical_code::get_code_words(lengths);
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+        if (!shared.words[symbol].length)
+            throw std::invalid_argument("file is corrupted");
+    }
+    shared.table = std::make_shared<const decode_table>(canonical_code::get_code_to_symbol(lengths));
+    std::string serialized;
+    canonical_code::write_lengths(serialized, lengths);
+    shared.id = checksum::crc32(serialized.data(), serialized.size());
+    return shared;
+}
+
+void dictionary_trainer::write(const dictionary& shared, const std::string& output_filename) {
+    std::string output(DICTIONARY_MAGIC, 4);
+    output += (char)DICTIONARY_VERSION;
+    output.append((const char*)&shared.id, sizeof(shared.id));
+    canonical_code::write_lengths(output, shared.lengths);
+    std::ofstream output_file(output_filename, std::ios::binary);
+    if (!output_file.is_open())
+        throw std::invalid_argument("no file");
+    output_file.write(output.data(), output.size());
+    output_file.close();
+    std::cout << shared.id << std::endl << output.size() << std::endl;
+}
+
+dictionary dictionary_decoder::read(const std::string& dictionary_filename) {
+    mapped_input input(dictionary_filename);
+    const std::size_t header_size = 5 + sizeof(std::uint32_t);
+    if (input.size() < header_size || std::memcmp(input.data(), DICTIONARY_MAGIC, 4) != 0)
+        throw std::invalid_argument("file is corrupted");
+    if ((unsigned char)input.data()[4] != DICTIONARY_VERSION)
+        throw std::invalid_argument("unsupported version");
+    std::uint32_t id;
+    std::memcpy(&id, input.data() + 5, sizeof(id));
+    std::vector<unsigned char> lengths;
+    if (canonical_code::read_lengths(input.data() + header_size, input.size() - header_size, lengths) != input.size() - header_size)
+        throw std::invalid_argument("file is corrupted");
+    dictionary shared = dictionary_trainer::make_dictionary(lengths);
+    if (shared.id != id)
+        throw std::invalid_argument("file is corrupted");
+    return shared;
+}
+
+std::string dictionary_encoder::encode_message(const dictionary& shared, const char* data, std::size_t size) {
+    if (size > UINT32_MAX)
+        throw std::invalid_argument("message is too long");
+    std::uint32_t size_of_message = size;
+    std::string output(MESSAGE_MAGIC, 4);
+    output.append((const char*)&shared.id, sizeof(shared.id));
+    output.append((const char*)&size_of_message, sizeof(size_of_message));
+    bit_writer writer;
+    writer.reserve(size);
+    for (std::size_t i = 0; i < size; ++i)
+        writer.write(shared.words[(unsigned char)data[i]].bits, shared.words[(unsigned char)data[i]].length);
+    return output + writer.finish();
+}
+
+std::string dictionary_decoder::decode_message(const dictionary& shared, const char* data, std::size_t size) {
+    if (size < MESSAGE_HEADER_SIZE || std::memcmp(data, MESSAGE_MAGIC, 4) != 0)
+        throw std::invalid_argument("file is corrupted");
+    std::uint32_t id, size_of_message;
+    std::memcpy(&id, data + 4, sizeof(id));
+    std::memcpy(&size_of_message, data + 4 + sizeof(id), sizeof(size_of_message));
+    if (id != shared.id)
+        throw std::invalid_argument("wrong dictionary");
+    std::string output(size_of_message, '\0');
+    bit_reader<> reader(data + MESSAGE_HEADER_SIZE, size - MESSAGE_HEADER_SIZE);
+    std::size_t total_bits = (size - MESSAGE_HEADER_SIZE) * BYTE_SIZE;
+    for (std::size_t i = 0; i < output.size(); ++i) {
+        if (!shared.table->decode(reader, output[i]) || reader.position() > total_bits)
+            throw std::invalid_argument("file is corrupted");
+    }
+    return output;
+}
+
+void dictionary_encoder::encode(const std::string& dictionary_filename, const std::string& input_filename, const std::string& output_filename) {
+    dictionary shared = dictionary_decoder::read(dictionary_filename);
+    mapped_input input(input_filename);
+    std::string output = encode_message(shared, input.data(), input.size());
+    std::ofstream output_file(output_filename, std::ios::binary);
+    output_file.write(output.data(), output.size());
+    output_file.close();
+    std::cout << input.size() << std::endl << output.size() - MESSAGE_HEADER_SIZE << std::endl << MESSAGE_HEADER_SIZE << std::endl;
+}
+
+void dictionary_decoder::decode(const std::string& dictionary_filename, const std::string& input_filename, const std::string& output_filename) {
+    dictionary shared = read(dictionary_filename);
+    mapped_input input(input_filename);
+    std::string output = decode_message(shared, input.data(), input.size());
+    mapped_output output_file(output_filename, output.size());
+    std::memcpy(output_file.data(), output.data(), output.size());
+    output_file.close();
+    std::cout << input.size() - MESSAGE_HEADER_SIZE << std::endl << output.size() << std::endl << MESSAGE_HEADER_SIZE << std::endl;
+}
@@ -0,0 +1,156 @@
+#include "digram_coder.h"
+#include "bit_reader.h"
+#include "bit_writer.h"
+#include "decode_table.h"
+#include "huffman.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+using namespace huffman;
+
+// Symbols are byte values below ALPHABET_SIZE and ALPHABET_SIZE + index of the
+// pair in digrams above.
+std::vector<std::uint32_t> digram_coder::parse(const std::string& text, const std::vector<std::uint16_t>& digrams, std::vector<std::size_t>& counts) {
+    std::vector<std::int16_t> index(1 << 16, -1);
+    for (std::size_t i = 0; i < digrams.size(); ++i)
+        index[digrams[i]] = i;
+    counts.assign(ALPHABET_SIZE + digrams.size(), 0);
+    std::vector<std::uint32_t> symbols;
+    symbols.reserve(text.size());
+    const unsigned char* data = (const unsigned char*)text.data();
+    std::size_t i = 0;
+    while (i < text.size()) {
+        int pair = i + 1 < text.size() ? index[data[i] << 8 | data[i + 1]] : -1;
+        std::uint32_t symbol = pair < 0 ? data[i] : ALPHABET_SIZE + pair;
+        symbols.push_back(symbol);
+        ++counts[symbol];
+        i += pair < 0 ? 1 : 2;
+    }
+    return symbols;
+}
+
+// Entropy of the symbols plus the table: a length byte per used byte symbol
+// and three bytes per pair.
+double digram_coder::get_cost(const std::vector<std::size_t>& counts) {
+    double total = 0, bits = 0;
+    for (std::size_t symbol = 0; symbol < counts.size(); ++symbol) {
+        if (!counts[symbol])
+            continue;
+        total += counts[symbol];
+        bits -= counts[symbol] * std::log2((double)counts[symbol]);
+        bits += (symbol < ALPHABET_SIZE ? 1 : 3) * BYTE_SIZE;
+    }
+    return total ? bits + total * std::log2(total) : 0;
+}
+
+std::string digram_coder::encode(const std::string& text, std::size_t& size_of_table) {
+    std::vector<std::uint32_t> pairs(1 << 16, 0);
+    const unsigned char* data = (const unsigned char*)text.data();
+    for (std::size_t i = 0; i + 1 < text.size(); ++i)
+        ++pairs[data[i] << 8 | data[i + 1]];
+    std::vector<std::pair<std::uint32_t, std::uint16_t>> order;
+    for (std::size_t pair = 0; pair < pairs.size(); ++pair) {
+        if (pairs[pair] > 1)
+            order.emplace_back(pairs[pair], pair);
+    }
+    std::sort(order.rbegin(), order.rend());
+
+    // Candidate set sizes grow 4x; the parse with the smallest estimate wins.
+    std::vector<std::uint16_t> digrams, best_digrams;
+    std::vector<std::uint32_t> symbols;
+    std::vector<std::size_t> counts;
+    double best = 0;
+    for (std::size_t candidate = 16; ; candidate *= 4) {
+        candidate = std::min(candidate, std::min(order.size(), MAX_DIGRAMS));
+        digrams.clear();
+        for (std::size_t i = 0; i < candidate; ++i)
+            digrams.push_back(order[i].second);
+        std::vector<std::size_t> candidate_counts;
+        std::vector<std::uint32_t> parsed = parse(text, digrams, candidate_counts);
+        double cost = get_cost(candidate_counts);
+        if (best_digrams.empty() || cost < best) {
+            best = cost;
+            best_digrams = digrams;
+            symbols.swap(parsed);
+            counts.swap(candidate_counts);
+        }
+        if (candidate == std::min(order.size(), MAX_DIGRAMS))
+            break;
+    }
+
+    // Pairs the greedy parse never used are dropped and the rest renumbered.
+    std::vector<std::uint32_t> renumber(counts.size());
+    std::vector<std::size_t> used(counts.begin(), counts.begin() + ALPHABET_SIZE);
+    digrams.clear();
+    for (std::size_t symbol = 0; symbol < counts.size(); ++symbol) {
+        renumber[symbol] = symbol;
+        if (symbol >= ALPHABET_SIZE && counts[symbol]) {
+            renumber[symbol] = ALPHABET_SIZE + digrams.size();
+            digrams.push_back(best_digrams[symbol - ALPHABET_SIZE]);
+            used.push_back(counts[symbol]);
+        }
+    }
+    std::vector<unsigned char> lengths = canonical_code::get_lengths(used, DIGRAM_CODE_LENGTH);
+
+    std::string body;
+    body += (char)(digrams.size() & 0xff);
+    body += (char)(digrams.size() >> 8);
+    for (std::size_t i = 0; i < digrams.size(); ++i) {
+        body += (char)(digrams[i] >> 8);
+        body += (char)(digrams[i] & 0xff);
+        body += (char)lengths[ALPHABET_SIZE + i];
+    }
+    canonical_code::write_lengths(body, std::vector<unsigned char>(lengths.begin(), lengths.begin() + ALPHABET_SIZE));
+    size_of_table = body.size();
+
+    std::vector<code_word> words = canonical_code::get_code_words(lengths);
+    bit_writer writer;
+    writer.reserve(text.size());
+    for (std::uint32_t symbol : symbols) {
+        const code_word& word = words[renumber[symbol]];
+        writer.write(word.bits, word.length);
+    }
+    return body + writer.finish();
+}
+
+std::size_t digram_coder::decode(const char* body, std::size_t size, char* output, std::size_t size_of_output) {
+    if (size < 2)
+        throw std::invalid_argument("file is corrupted");
+    std::size_t count = (unsigned char)body[0] | (std::size_t)(unsigned char)body[1] << 8;
+    std::size_t position = 2 + 3 * count;
+    if (count > MAX_DIGRAMS || position > size)
+        throw std::invalid_argument("file is corrupted");
+    std::vector<unsigned char> lengths;
+    position += canonical_code::read_lengths(body + position, size - position, lengths);
+    std::vector<digram> symbols(ALPHABET_SIZE + count);
+    for (std::size_t symbol = 0; symbol < ALPHABET_SIZE; ++symbol) {
+        symbols[symbol].count = 1;
+        symbols[symbol].bytes[0] = symbol;
+    }
+    for (std::size_t i = 0; i < count; ++i) {
+        digram& entry = symbols[ALPHABET_SIZE + i];
+        entry.count = 2;
+        entry.bytes[0] = body[2 + 3 * i];
+        entry.bytes[1] = body[2 + 3 * i + 1];
+        lengths.push_back(body[2 + 3 * i + 2]);
+    }
+    canonical_table table(lengths, DIGRAM_CODE_LENGTH);
+
+    bit_reader<> reader(body + position, size - position);
+    std::size_t total_bits = (size - position) * BYTE_SIZE, written = 0;
+    std::uint32_t symbol;
+    while (written < size_of_output) {
+        if (!table.decode(reader, symbol))
+            throw std::invalid_argument("file is corrupted");
+        const digram& entry = symbols[symbol];
+        if (written + entry.count > size_of_output)
+            throw std::invalid_argument("file is corrupted");
+        output[written++] = entry.bytes[0];
+        if (entry.count == 2)
+            output[written++] = entry.bytes[1];
+    }
+    if (reader.position() > total_bits)
+        throw std::invalid_argument("file is corrupted");
+    return position;
+}
@@ -1,8 +1,18 @@
 #include "huffman.h"
+#include "bit_reader.h"
+#include "block_format.h"
+#include "decode_table.h"
+#include "mapped_file.h"
+#include "parallel_decoder.h"
+#include "transforms.h"
 #include <stdexcept>
 #include <queue>
 #include <vector>
+#include <cstring>
 #include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <bitset>
 
 using namespace huffman;
 
@@ -93,6 +103,18 @@ std::map<char, std::size_t> huffman_encoder::get_table(std::ifstream& file) {
     return table;
 }
 
+std::map<char, std::size_t> huffman_encoder::get_table(const std::string& text) {
+    std::size_t counts[1 << BYTE_SIZE] = {};
+    for (char symbol : text)
+        ++counts[(unsigned char)symbol];
+    std::map<char, std::size_t> table;
+    for (std::size_t i = 0; i < (1 << BYTE_SIZE); ++i) {
+        if (counts[i])
+            table[(char)i] = counts[i];
+    }
+    return table;
+}
+
 std::string huffman_encoder::get_encoded_text(std::ifstream& file, std::map<char, std::string>& codes, std::size_t& size_of_file) {
     std::string final_text = "";
     file.clear();
@@ -112,11 +134,109 @@ std::string huffman_encoder::get_encoded_text(std::ifstream& file, std::map<char
     return final_text;
 }
 
-std::size_t huffman_encoder::write_additional_information(std::ofstream& file, std::map<char, std::size_t>& table, std::size_t size_of_file) {
-    std::size_t size_of_table = table.size(), additional_information = 0;
+std::string huffman_encoder::get_encoded_text(const std::string& text, std::map<char, std::string>& codes, std::vector<std::size_t>& index, std::size_t index_interval) {
+    std::string final_text = "";
+    for (std::size_t i = 0; i < text.size(); ++i) {
+        if (index_interval && i && i % index_interval == 0)
+            index.push_back(final_text.size());
+        final_text += codes[text[i]];
+    }
+    while (final_text.size() % BYTE_SIZE != 0)
+        final_text += '0';
+    return final_text;
+}
+
+// Size of the output for this table: header, per-symbol entries and payload.
+// A single-symbol table needs no payload at all.
+std::size_t huffman_encoder::get_encoded_size(const std::map<char, std::size_t>& table, std::size_t entry_size) {
+    std::size_t bits = 0;
+    if (table.size() > 1) {
+        for (const std::pair<const char, std::string>& code : huffman_tree(table).get_symbol_to_code())
+            bits += table.at(code.first) * code.second.size();
+    }
+    return 2 * sizeof(std::size_t) + table.size() * entry_size + (bits + BYTE_SIZE - 1) / BYTE_SIZE;
+}
+
+// Payload bits of a Huffman code for these counts, sorted ascending: the sum of
+// all merged weights. Merged weights come out in order, so two queues replace
+// the heap and no codes are built.
+std::size_t huffman_encoder::get_optimal_bits(const std::vector<std::size_t>& counts) {
+    std::vector<std::size_t> merged;
+    merged.reserve(counts.size());
+    std::size_t leaf = 0, node = 0, bits = 0;
+    auto next = [&]() {
+        if (node == merged.size() || (leaf < counts.size() && counts[leaf] <= merged[node]))
+            return counts[leaf++];
+        return merged[node++];
+    };
+    for (std::size_t i = 1; i < counts.size(); ++i) {
+        std::size_t weight = next();
+        weight += next();
+        bits += weight;
+        merged.push_back(weight);
+    }
+    return bits;
+}
+
+// Folds the least frequent symbols into one escape entry, coded as the escape
+// code followed by the raw byte. The number of folded symbols is the one with
+// the smallest estimated output: header entries saved against literal bits added.
+std::size_t huffman_encoder::fold_rare_symbols(std::map<char, std::size_t>& table, char& escape, std::size_t entry_size) {
+    std::vector<std::pair<std::size_t, char>> symbols;
+    for (const std::pair<const char, std::size_t>& symbol : table)
+        symbols.emplace_back(symbol.second, symbol.first);
+    std::sort(symbols.begin(), symbols.end());
+    std::size_t best_size = get_encoded_size(table, entry_size), best_count = 0, rare = symbols.empty() ? 0 : symbols[0].first;
+    std::vector<std::size_t> counts;
+    for (std::size_t count = 2; count < symbols.size(); ++count) {
+        rare += symbols[count - 1].first;
+        counts.clear();
+        for (std::size_t i = count; i < symbols.size(); ++i)
+            counts.push_back(symbols[i].first);
+        counts.insert(std::upper_bound(counts.begin(), counts.end(), rare), rare);
+        std::size_t size = 2 * sizeof(std::size_t) + counts.size() * entry_size + (get_optimal_bits(counts) + BYTE_SIZE - 1) / BYTE_SIZE + rare + 1;
+        if (size < best_size) {
+            best_size = size;
+            best_count = count;
+        }
+    }
+    if (best_count) {
+        escape = symbols[best_count - 1].second;
+        for (std::size_t i = 0; i < best_count; ++i)
+            table.erase(symbols[i].second);
+        table[escape] = 0;
+        for (std::size_t i = 0; i < best_count; ++i)
+            table[escape] += symbols[i].first;
+    }
+    return best_count;
+}
+
+std::map<char, std::string> huffman_encoder::get_codes(const std::map<char, std::size_t>& table, const std::map<char, std::size_t>& folded, int escape) {
+    std::map<char, std::string> codes = huffman_tree(folded).get_symbol_to_code();
+    if (escape != NO_ESCAPE) {
+        std::string escape_code = codes[(char)escape];
+        for (const std::pair<const char, std::size_t>& symbol : table) {
+            if (!folded.count(symbol.first) || symbol.first == (char)escape)
+                codes[symbol.first] = escape_code + std::bitset<BYTE_SIZE>((unsigned char)symbol.first).to_string();
+        }
+    }
+    return codes;
+}
+
+std::size_t huffman_encoder::write_additional_information(std::ofstream& file, std::map<char, std::size_t>& table, std::size_t size_of_file, std::size_t size_of_runs, int escape) {
+    std::size_t size_of_table = table.size() | (size_of_runs ? RUN_LENGTH_FLAG : 0) | (escape != NO_ESCAPE ? ESCAPE_FLAG : 0), additional_information = 0;
     file.write((char*)&size_of_table, sizeof(size_of_table));
     file.write((char*)&size_of_file, sizeof(size_of_file));
     additional_information += 2 * sizeof(std::size_t);
+    if (size_of_runs) {
+        file.write((char*)&size_of_runs, sizeof(size_of_runs));
+        additional_information += sizeof(std::size_t);
+    }
+    if (escape != NO_ESCAPE) {
+        char symbol = escape;
+        file.write(&symbol, 1);
+        ++additional_information;
+    }
     for (std::pair<char, std::size_t> symbol : table) {
         file.write(&symbol.first, 1);
         ++additional_information;
@@ -135,17 +255,44 @@ void huffman_encoder::write_encoded_text(std::ofstream& file, const std::string&
 
 }
 
+// Optional trailer: bit offsets of every index_interval-th symbol, followed by
+// the interval, the number of offsets and INDEX_MAGIC.
+std::size_t huffman_encoder::write_index(std::ofstream& file, const std::vector<std::size_t>& index, std::size_t index_interval) {
+    std::size_t count = index.size();
+    file.write((const char*)index.data(), count * sizeof(std::size_t));
+    file.write((char*)&index_interval, sizeof(index_interval));
+    file.write((char*)&count, sizeof(count));
+    file.write(INDEX_MAGIC, sizeof(std::size_t));
+    return (count + 3) * sizeof(std::size_t);
+}
+
 char huffman_decoder::get_bit(char& byte, std::size_t index) {
     if (index > BYTE_SIZE || index < 1)
         throw std::invalid_argument("1 <= index <= 8");
     return (byte & (1 << (BYTE_SIZE - index))) ? '1' : '0';
 }
 
-std::size_t huffman_decoder::get_additional_information(std::ifstream& file, std::map<char, std::size_t>& table, std::size_t& size_of_file) {
+std::size_t huffman_decoder::get_additional_information(std::ifstream& file, std::map<char, std::size_t>& table, std::size_t& size_of_file, std::size_t& size_of_runs, int& escape) {
     std::size_t size_of_table, additional_information = 0;
     file.read((char*)&size_of_table, sizeof(std::size_t));
     file.read((char*)&size_of_file, sizeof(std::size_t));
     additional_information += 2 * sizeof(std::size_t);
+    size_of_runs = 0;
+    if (size_of_table & RUN_LENGTH_FLAG) {
+        size_of_table &= ~RUN_LENGTH_FLAG;
+        file.read((char*)&size_of_runs, sizeof(std::size_t));
+        additional_information += sizeof(std::size_t);
+    }
+    escape = NO_ESCAPE;
+    if (size_of_table & ESCAPE_FLAG) {
+        size_of_table &= ~ESCAPE_FLAG;
+        char symbol;
+        file.read(&symbol, 1);
+        escape = (unsigned char)symbol;
+        ++additional_information;
+    }
+    if (!file || size_of_table > (1 << BYTE_SIZE))
+        throw std::invalid_argument("file is corrupted");
     for (std::size_t i = 0; i < size_of_table; ++i) {
         char symbol;
         file.read(&symbol, 1);
@@ -158,62 +305,207 @@ std::size_t huffman_decoder::get_additional_information(std::ifstream& file, std
     return additional_information;
 }
 
-std::size_t huffman_decoder::write_decoded_text(std::ofstream& output_file, std::ifstream& input_file, std::map<std::string, char> codes, std::size_t size_of_file) {
-    std::string current_code = "";
-    std::size_t count_of_writed_symbols = 0, size_of_compressed_file = 0;
-    while (true) {
-        char byte;
-        input_file.read(&byte, 1);
-        if (input_file.eof()) {
-            input_file.close();
-            output_file.close();
+std::size_t huffman_decoder::get_index(std::ifstream& file, std::vector<std::size_t>& index, std::size_t& index_interval) {
+    std::streampos position = file.tellg();
+    file.seekg(0, std::ios::end);
+    std::size_t size = file.tellg(), count = 0, size_of_trailer = 0;
+    char magic[sizeof(std::size_t)];
+    index_interval = 0;
+    if (size >= (std::size_t)position + 3 * sizeof(std::size_t)) {
+        file.seekg(size - 2 * sizeof(std::size_t));
+        file.read((char*)&count, sizeof(count));
+        file.read(magic, sizeof(magic));
+        size_of_trailer = (count + 3) * sizeof(std::size_t);
+        if (std::memcmp(magic, INDEX_MAGIC, sizeof(magic)) != 0 || size_of_trailer > size - (std::size_t)position)
+            size_of_trailer = 0;
+    }
+    if (size_of_trailer) {
+        file.seekg(size - size_of_trailer);
+        index.resize(count);
+        file.read((char*)index.data(), count * sizeof(std::size_t));
+        file.read((char*)&index_interval, sizeof(index_interval));
+        if (!index_interval)
+            throw std::invalid_argument("file is corrupted");
+    }
+    file.clear();
+    file.seekg(position);
+    return size_of_trailer;
+}
+
+std::map<std::string, char> huffman_decoder::get_codes(const std::map<char, std::size_t>& table) {
+    return huffman_tree(table).get_code_to_symbol();
+}
+
+std::string huffman_decoder::get_payload(std::ifstream& input_file) {
+    std::vector<std::size_t> index;
+    std::size_t index_interval;
+    std::size_t size_of_trailer = get_index(input_file, index, index_interval);
+    std::string payload((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
+    input_file.close();
+    payload.resize(payload.size() - size_of_trailer);
+    return payload;
+}
+
+std::size_t huffman_decoder::write_decoded_text(char* output, std::ifstream& input_file, const decode_table& table, std::size_t size_of_file) {
+    std::string payload = get_payload(input_file);
+    std::size_t total_bits = payload.size() * BYTE_SIZE;
+    bit_reader<> reader(payload);
+    for (std::size_t i = 0; i < size_of_file; ++i) {
+        if (!table.decode(reader, output[i]) || reader.position() > total_bits)
             throw std::invalid_argument("file is corrupted");
-        }
-        ++size_of_compressed_file;
-        for (std::size_t j = 1; j <= BYTE_SIZE; ++j) {
-            current_code += get_bit(byte, j);
-            if (codes.find(current_code) != codes.end()) {
-                output_file << codes[current_code];
-                current_code = "";
-                if (++count_of_writed_symbols == size_of_file) {
-                    input_file.close();
-                    output_file.close();
-                    return size_of_compressed_file;
-                }
-            }
-        }
     }
+    return (reader.position() + BYTE_SIZE - 1) / BYTE_SIZE;
 }
 
-void huffman_encoder::encode(const std::string& input_filename, const std::string& output_filename) {
+std::size_t huffman_decoder::write_decoded_text_parallel(char* output, std::ifstream& input_file, const decode_table& table, std::size_t size_of_file, std::size_t threads) {
+    std::string payload = get_payload(input_file);
+    return parallel_decoder::decode(payload, table, output, size_of_file, threads);
+}
+
+void huffman_encoder::encode(const std::string& input_filename, const std::string& output_filename, std::size_t index_interval, bool escape_rare) {
     std::ifstream input_file(input_filename, std::ios::binary);
     if (!input_file.is_open())
         throw std::invalid_argument("no file");
-    std::map<char, std::size_t> table = get_table(input_file);
-    std::map<char, std::string> codes = huffman_tree(table).get_symbol_to_code();
-    std::size_t size_of_file = 0;
-    std::string final_text = get_encoded_text(input_file, codes, size_of_file);
+    std::string text((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
+    input_file.close();
+    std::map<char, std::size_t> table = get_table(text);
+    std::size_t size_of_file = text.size(), size_of_runs = 0;
+    if (table.size() > 1) {
+        std::string runs = run_length::encode(text);
+        std::map<char, std::size_t> runs_table = get_table(runs);
+        if (get_encoded_size(runs_table) + sizeof(std::size_t) < get_encoded_size(table)) {
+            text.swap(runs);
+            table.swap(runs_table);
+            size_of_runs = text.size();
+            index_interval = 0;
+        }
+    }
+    std::map<char, std::size_t> folded(table);
+    char escape_symbol;
+    int escape = NO_ESCAPE;
+    if (escape_rare && fold_rare_symbols(folded, escape_symbol))
+        escape = (unsigned char)escape_symbol;
+    std::string final_text;
+    std::vector<std::size_t> index;
+    if (table.size() > 1) {
+        std::map<char, std::string> codes = get_codes(table, folded, escape);
+        final_text = get_encoded_text(text, codes, index, index_interval);
+    }
     std::ofstream output_file(output_filename, std::ios::binary);
-    std::size_t additional_information = write_additional_information(output_file, table, size_of_file);
+    std::size_t additional_information = write_additional_information(output_file, folded, size_of_file, size_of_runs, escape);
     huffman_encoder::write_encoded_text(output_file, final_text);
+    if (index_interval)
+        additional_information += write_index(output_file, index, index_interval);
     output_file.close();
     std::cout << size_of_file << std::endl << final_text.size() / BYTE_SIZE << std::endl << additional_information << std::endl;
 }
 
-void huffman_decoder::decode(const std::string& input_filename, const std::string& output_filename) {
+void huffman_decoder::decode(const std::string& input_filename, const std::string& output_filename, std::size_t threads) {
     std::ifstream input_file(input_filename, std::ios::binary);
     if (!input_file.is_open())
         throw std::invalid_argument("no file");
-    std::size_t size_of_file;
+    if (block_decoder::is_block_file(input_file)) {
+        input_file.close();
+        block_decoder::decode(input_filename, output_filename, threads);
+        return;
+    }
+    std::size_t size_of_file, size_of_runs;
+    int escape;
     std::map<char, std::size_t> table;
-    std::size_t additional_information = get_additional_information(input_file, table, size_of_file);
-    std::ofstream output_file(output_filename);
-    if (size_of_file == 0) {
+    std::size_t additional_information = get_additional_information(input_file, table, size_of_file, size_of_runs, escape);
+    mapped_output output_file(output_filename, size_of_file);
+    if (size_of_file == 0 || (table.size() == 1 && !size_of_runs)) {
+        if (size_of_file)
+            std::memset(output_file.data(), table.begin()->first, size_of_file);
         output_file.close();
         std::cout << 0 << std::endl << size_of_file << std::endl << additional_information << std::endl;
         return;
     }
-    std::map<std::string, char> codes = huffman_tree(table).get_code_to_symbol();
-    std::size_t size_of_compressed_file = huffman_decoder::write_decoded_text(output_file, input_file, codes, size_of_file);
+    std::string runs(size_of_runs, '\0');
+    char* symbols = size_of_runs ? &runs[0] : output_file.data();
+    std::size_t size_of_symbols = size_of_runs ? size_of_runs : size_of_file;
+    decode_table codes(get_codes(table), escape);
+    std::size_t size_of_compressed_file;
+    if (threads > 1)
+        size_of_compressed_file = huffman_decoder::write_decoded_text_parallel(symbols, input_file, codes, size_of_symbols, threads);
+    else
+        size_of_compressed_file = huffman_decoder::write_decoded_text(symbols, input_file, codes, size_of_symbols);
+    if (size_of_runs)
+        run_length::decode(runs, output_file.data(), size_of_file);
+    output_file.close();
     std::cout << size_of_compressed_file << std::endl << size_of_file << std::endl << additional_information << std::endl;
 }
+
+void huffman_decoder::decode_range(const std::string& input_filename, const std::string& output_filename, std::size_t begin, std::size_t end) {
+    std::ifstream input_file(input_filename, std::ios::binary);
+    if (!input_file.is_open())
+        throw std::invalid_argument("no file");
+    if (block_decoder::is_block_file(input_file)) {
+        input_file.close();
+        block_decoder::decode_range(input_filename, output_filename, begin, end);
+        return;
+    }
+    std::size_t size_of_file, size_of_runs;
+    int escape;
+    std::map<char, std::size_t> table;
+    std::size_t additional_information = get_additional_information(input_file, table, size_of_file, size_of_runs, escape);
+    end = std::min(end, size_of_file);
+    if (begin > end)
+        throw std::invalid_argument("invalid range");
+    mapped_output output_file(output_filename, end - begin);
+    if (begin == end || (table.size() == 1 && !size_of_runs)) {
+        if (begin != end)
+            std::memset(output_file.data(), table.begin()->first, end - begin);
+        output_file.close();
+        std::cout << 0 << std::endl << end - begin << std::endl << additional_information << std::endl;
+        return;
+    }
+    if (size_of_runs) {
+        // Run-length files carry no index, the whole stream is decoded and sliced.
+        std::string runs(size_of_runs, '\0'), text(size_of_file, '\0');
+        std::size_t size_of_compressed_file = write_decoded_text(&runs[0], input_file, decode_table(get_codes(table), escape), size_of_runs);
+        run_length::decode(runs, &text[0], size_of_file);
+        std::memcpy(output_file.data(), text.data() + begin, end - begin);
+        output_file.close();
+        std::cout << size_of_compressed_file << std::endl << end - begin << std::endl << additional_information << std::endl;
+        return;
+    }
+
+    std::vector<std::size_t> index;
+    std::size_t index_interval;
+    std::size_t size_of_trailer = get_index(input_file, index, index_interval);
+    std::size_t payload_begin = input_file.tellg();
+    input_file.seekg(0, std::ios::end);
+    std::size_t last_bit = ((std::size_t)input_file.tellg() - size_of_trailer - payload_begin) * BYTE_SIZE;
+    std::size_t sample = 0;
+    if (index_interval) {
+        sample = std::min(begin / index_interval, index.size());
+        std::size_t next = (end + index_interval - 1) / index_interval;
+        if (next <= index.size())
+            last_bit = index[next - 1];
+    }
+    std::size_t first_symbol = sample * index_interval, first_bit = sample ? index[sample - 1] : 0;
+    if (first_bit > last_bit)
+        throw std::invalid_argument("file is corrupted");
+
+    std::size_t first_byte = first_bit / BYTE_SIZE;
+    std::string window((last_bit + BYTE_SIZE - 1) / BYTE_SIZE - first_byte, '\0');
+    input_file.clear();
+    input_file.seekg(payload_begin + first_byte);
+    input_file.read(&window[0], window.size());
+    input_file.close();
+
+    decode_table codes(get_codes(table), escape);
+    bit_reader<> reader(window, first_bit - first_byte * BYTE_SIZE);
+    std::size_t total_bits = window.size() * BYTE_SIZE;
+    char* output = output_file.data();
+    for (std::size_t i = first_symbol; i < end; ++i) {
+        char symbol;
+        if (!codes.decode(reader, symbol) || reader.position() > total_bits)
+            throw std::invalid_argument("file is corrupted");
+        if (i >= begin)
+            output[i - begin] = symbol;
+    }
+    output_file.close();
+    std::cout << window.size() << std::endl << end - begin << std::endl << additional_information + size_of_trailer << std::endl;
+}
@@ -0,0 +1,187 @@
+#include "lz77_coder.h"
+#include "bit_reader.h"
+#include "bit_writer.h"
+#include "canonical_code.h"
+#include "decode_table.h"
+#include "huffman.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace huffman;
+
+// Values below 4 are codes of their own; above, every power of two is split
+// into two codes, followed by the bits below the top two.
+void lz77_coder::get_code(std::uint32_t value, std::uint32_t& code, std::uint32_t& extra_bits) {
+    if (value < 4) {
+        code = value;
+        extra_bits = 0;
+        return;
+    }
+    std::uint32_t top = 31 - __builtin_clz(value);
+    code = 2 * top + ((value >> (top - 1)) & 1);
+    extra_bits = top - 1;
+}
+
+std::vector<lz77_coder::token> lz77_coder::find_matches(const std::string& text, std::size_t depth) {
+    const unsigned char* data = (const unsigned char*)text.data();
+    std::size_t size = text.size();
+    std::vector<std::int32_t> head(std::size_t(1) << MATCH_HASH_BITS, -1), previous(size, -1);
+    auto hash = [&](std::size_t i) {
+        return (std::uint32_t)((data[i] | data[i + 1] << 8 | data[i + 2] << 16) * 2654435761u) >> (32 - MATCH_HASH_BITS);
+    };
+    auto insert = [&](std::size_t i) {
+        if (i + MIN_MATCH <= size) {
+            std::uint32_t key = hash(i);
+            previous[i] = head[key];
+            head[key] = i;
+        }
+    };
+    // Longest match for i among the inserted positions; short matches far
+    // back cost more than the literals they replace.
+    auto find = [&](std::size_t i, token& match) {
+        match.length = 0;
+        if (i + MIN_MATCH > size)
+            return;
+        std::size_t limit = std::min(MAX_MATCH, size - i);
+        std::int32_t candidate = head[hash(i)];
+        for (std::size_t tries = 0; candidate >= 0 && tries < depth; ++tries, candidate = previous[candidate]) {
+            if (data[candidate + match.length] != data[i + match.length])
+                continue;
+            std::size_t length = 0;
+            while (length < limit && data[candidate + length] == data[i + length])
+                ++length;
+            if (length > match.length && (length > MIN_MATCH || i - candidate <= FAR_MATCH_DISTANCE)) {
+                match.length = length;
+                match.value = i - candidate;
+                if (length == limit)
+                    break;
+            }
+        }
+        if (match.length < MIN_MATCH)
+            match.length = 0;
+    };
+
+    std::vector<token> tokens;
+    tokens.reserve(size / 2);
+    token current, next, literal;
+    for (std::size_t i = 0; i < size;) {
+        find(i, current);
+        insert(i);
+        while (current.length && i + 1 < size) {
+            find(i + 1, next);
+            if (next.length <= current.length)
+                break;
+            literal.value = data[i++];
+            tokens.push_back(literal);
+            insert(i);
+            current = next;
+        }
+        if (!current.length) {
+            literal.value = data[i++];
+            tokens.push_back(literal);
+            continue;
+        }
+        tokens.push_back(current);
+        for (std::size_t k = 1; k < current.length; ++k)
+            insert(i + k);
+        i += current.length;
+    }
+    return tokens;
+}
+
+std::string lz77_coder::encode(const std::string& text, std::size_t depth, std::size_t& size_of_table) {
+    std::vector<token> tokens = find_matches(text, std::max<std::size_t>(depth, 1));
+    std::vector<std::size_t> literal_counts(LITERAL_CODES, 0), distance_counts(DISTANCE_CODES, 0);
+    std::uint32_t code, extra_bits;
+    for (const token& item : tokens) {
+        if (!item.length) {
+            ++literal_counts[item.value];
+            continue;
+        }
+        get_code(item.length - MIN_MATCH, code, extra_bits);
+        ++literal_counts[256 + code];
+        get_code(item.value - 1, code, extra_bits);
+        ++distance_counts[code];
+    }
+    std::vector<unsigned char> lengths = canonical_code::get_lengths(literal_counts, LZ77_CODE_LENGTH);
+    std::vector<unsigned char> distance_lengths = canonical_code::get_lengths(distance_counts, LZ77_CODE_LENGTH);
+    lengths.insert(lengths.end(), distance_lengths.begin(), distance_lengths.end());
+
+    // Code lengths fit in 4 bits, two to a byte.
+    std::string body((lengths.size() + 1) / 2, '\0');
+    for (std::size_t i = 0; i < lengths.size(); ++i)
+        body[i / 2] |= lengths[i] << (i % 2 ? 0 : 4);
+    size_of_table = body.size();
+
+    std::vector<code_word> literals = canonical_code::get_code_words(std::vector<unsigned char>(lengths.begin(), lengths.begin() + LITERAL_CODES));
+    std::vector<code_word> distances = canonical_code::get_code_words(distance_lengths);
+    bit_writer writer;
+    writer.reserve(text.size() / 2);
+    for (const token& item : tokens) {
+        if (!item.length) {
+            writer.write(literals[item.value].bits, literals[item.value].length);
+            continue;
+        }
+        std::uint32_t value = item.length - MIN_MATCH;
+        get_code(value, code, extra_bits);
+        writer.write(literals[256 + code].bits, literals[256 + code].length);
+        writer.write(value & ((1u << extra_bits) - 1), extra_bits);
+        value = item.value - 1;
+        get_code(value, code, extra_bits);
+        writer.write(distances[code].bits, distances[code].length);
+        writer.write(value & ((1u << extra_bits) - 1), extra_bits);
+    }
+    return body + writer.finish();
+}
+
+std::size_t lz77_coder::decode(const char* body, std::size_t size, char* output, std::size_t size_of_output) {
+    std::size_t position = (LITERAL_CODES + DISTANCE_CODES + 1) / 2;
+    if (size < position)
+        throw std::invalid_argument("file is corrupted");
+    std::vector<unsigned char> lengths(LITERAL_CODES), distance_lengths(DISTANCE_CODES);
+    for (std::size_t i = 0; i < LITERAL_CODES + DISTANCE_CODES; ++i) {
+        unsigned char length = (unsigned char)body[i / 2] >> (i % 2 ? 0 : 4) & 0xf;
+        if (i < LITERAL_CODES)
+            lengths[i] = length;
+        else
+            distance_lengths[i - LITERAL_CODES] = length;
+    }
+    canonical_table literals(lengths, LZ77_CODE_LENGTH), distances(distance_lengths, LZ77_CODE_LENGTH);
+
+    bit_reader<> reader(body + position, size - position);
+    std::size_t total_bits = (size - position) * BYTE_SIZE, written = 0;
+    std::uint32_t symbol;
+    auto read_value = [&](std::uint32_t code) {
+        if (code < 4)
+            return code;
+        std::uint32_t extra_bits = code / 2 - 1;
+        return (2 | (code & 1)) << extra_bits | (std::uint32_t)reader.read(extra_bits);
+    };
+    while (written < size_of_output) {
+        if (!literals.decode(reader, symbol))
+            throw std::invalid_argument("file is corrupted");
+        if (symbol < 256) {
+            output[written++] = symbol;
+            continue;
+        }
+        std::size_t length = read_value(symbol - 256) + MIN_MATCH;
+        if (!distances.decode(reader, symbol))
+            throw std::invalid_argument("file is corrupted");
+        std::size_t distance = (std::size_t)read_value(symbol) + 1;
+        if (distance > written || length > size_of_output - written)
+            throw std::invalid_argument("file is corrupted");
+        char* target = output + written;
+        const char* source = target - distance;
+        if (distance >= length)
+            std::memcpy(target, source, length);
+        else {
+            for (std::size_t i = 0; i < length; ++i)
+                target[i] = source[i];
+        }
+        written += length;
+    }
+    if (reader.position() > total_bits)
+        throw std::invalid_argument("file is corrupted");
+    return position;
+}
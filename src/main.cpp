@@ -1,38 +1,191 @@
+#include "archive.h"
+#include "block_format.h"
+#include "dictionary.h"
 #include "huffman.h"
+#include "stream_format.h"
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <vector>
 
 int main(int argc, char* argv[]) {
-	if (argc != 6) {
+	std::string input_filename, output_filename, dictionary_filename, type_flag;
+	std::size_t threads = 1, index_interval = 0;
+	std::size_t range_begin = 0, range_end = std::numeric_limits<std::size_t>::max();
+	bool has_range = false, legacy = false, stream = false, throughput = false;
+	std::vector<std::string> members;
+	huffman::encoder_options options = huffman::block_encoder::get_level(huffman::DEFAULT_LEVEL);
+	try {
+		// The level only sets defaults, the other flags override it wherever they stand.
+		for (int i = 1; i < argc; ++i) {
+			std::string flag = std::string(argv[i]);
+			if (flag.size() == 2 && flag[0] == '-' && flag[1] >= '1' && flag[1] <= '9')
+				options = huffman::block_encoder::get_level(flag[1] - '0');
+		}
+		for (int i = 1; i < argc; ++i) {
+			std::string flag = std::string(argv[i]);
+			bool has_value = i + 1 < argc;
+			if (flag == "-c" || flag == "-u" || flag == "-a" || flag == "-l" || flag == "-x") {
+				type_flag = flag;
+			}
+			else if (flag.size() == 2 && flag[0] == '-' && flag[1] >= '1' && flag[1] <= '9') {
+			}
+			else if (flag == "train" && i == 1) {
+				type_flag = flag;
+			}
+			else if ((flag == "-d" || flag == "--dictionary") && has_value) {
+				dictionary_filename = std::string(argv[++i]);
+			}
+			else if (flag == "--archive" || flag == "--list" || flag == "--extract") {
+				type_flag = flag.substr(1, 2);
+			}
+			else if ((flag == "-f" || flag == "--file") && has_value) {
+				input_filename = std::string(argv[++i]);
+			}
+			else if ((flag == "-o" || flag == "--output") && has_value) {
+				output_filename = std::string(argv[++i]);
+			}
+			else if ((flag == "-t" || flag == "--threads") && has_value) {
+				threads = std::stoul(argv[++i]);
+			}
+			else if ((flag == "-b" || flag == "--block-size") && has_value) {
+				options.block_size = std::stoul(argv[++i]);
+				options.adaptive = false;
+			}
+			else if (flag == "--shard" && has_value) {
+				std::string shard = std::string(argv[++i]);
+				std::size_t separator = shard.find('/');
+				if (separator == std::string::npos)
+					exit(1);
+				options.shard_index = std::stoul(shard.substr(0, separator));
+				options.shard_count = std::stoul(shard.substr(separator + 1));
+			}
+			else if (flag == "--coder" && has_value) {
+				options.coder = huffman::block_encoder::get_coder(argv[++i]);
+			}
+			else if (flag == "--match-depth" && has_value) {
+				options.match_depth = std::stoul(argv[++i]);
+			}
+			else if (flag == "-e" || flag == "--escape") {
+				options.escape_rare = true;
+			}
+			else if (flag == "--auto") {
+				options.auto_select = true;
+			}
+			else if (flag == "--filter") {
+				options.filter_blocks = true;
+			}
+			else if (flag == "--bwt") {
+				options.sort_blocks = true;
+				options.adaptive = false;
+			}
+			else if (flag == "-i" || flag == "--index") {
+				index_interval = huffman::INDEX_INTERVAL;
+				legacy = true;
+			}
+			else if (flag == "-s" || flag == "--stream") {
+				stream = true;
+			}
+			else if (flag == "--flush" && has_value) {
+				options.flush_interval = std::stoul(argv[++i]);
+			}
+			else if (flag == "--append") {
+				options.append = true;
+			}
+			else if (flag == "--throughput") {
+				throughput = true;
+			}
+			else if (flag == "--legacy") {
+				legacy = true;
+			}
+			else if ((flag == "-r" || flag == "--range") && has_value) {
+				std::string range = std::string(argv[++i]);
+				std::size_t separator = range.find(':');
+				if (separator == std::string::npos)
+					exit(1);
+				range_begin = std::stoul(range.substr(0, separator));
+				if (separator + 1 < range.size())
+					range_end = std::stoul(range.substr(separator + 1));
+				has_range = true;
+			}
+			else if (!flag.empty() && flag[0] != '-') {
+				members.push_back(flag);
+			}
+			else {
+				exit(1);
+			}
+		}
+	}
+	catch(...) {
+		exit(1);
+	}
+	if ((type_flag == "-a" || type_flag == "train") && !input_filename.empty()) {
+		members.insert(members.begin(), input_filename);
+	}
+	if (type_flag.empty() || ((type_flag == "-a" || type_flag == "train") ? members.empty() : input_filename.empty())
+			|| (type_flag != "-l" && output_filename.empty()) || ((type_flag == "-c" || type_flag == "-u") && !members.empty())) {
 		exit(1);
 	}
 
-	std::string input_filename, output_filename, type_flag;
-	for (int i = 1; i < 6; ++i) {
-		std::string flag = std::string(argv[i]);
-		if (flag == "-c" || flag == "-u") {
-			type_flag = flag;
-		}	
-		else if (flag == "-f" || flag == "--file") {
-			input_filename = std::string(argv[++i]);
-		}
-		else if (flag == "-o" || flag == "--output") {
-			output_filename = std::string(argv[++i]);
-		}
-		else {
-			exit(1);
-		}
+	if (legacy && options.append) {
+		exit(1);
+	}
+	if (input_filename == huffman::STANDARD_STREAM || output_filename == huffman::STANDARD_STREAM) {
+		stream = true;
 	}
 
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
 	try {
-		if (type_flag == "-c") {
-			huffman::huffman_encoder::encode(input_filename, output_filename);
+		if (type_flag == "train") {
+			huffman::dictionary_trainer::write(huffman::dictionary_trainer::train(members), output_filename);
+		}
+		else if (type_flag == "-c" && !dictionary_filename.empty()) {
+			huffman::dictionary_encoder::encode(dictionary_filename, input_filename, output_filename);
+		}
+		else if (type_flag == "-u" && !dictionary_filename.empty()) {
+			huffman::dictionary_decoder::decode(dictionary_filename, input_filename, output_filename);
+		}
+		else if (type_flag == "-a") {
+			options.threads = threads;
+			huffman::archive_encoder::encode(members, output_filename, options);
+		}
+		else if (type_flag == "-l") {
+			huffman::archive_decoder::list(input_filename);
+		}
+		else if (type_flag == "-x") {
+			huffman::archive_decoder::extract(input_filename, output_filename, members, threads);
+		}
+		else if (type_flag == "-c" && legacy) {
+			huffman::huffman_encoder::encode(input_filename, output_filename, index_interval, options.escape_rare);
+		}
+		else if (type_flag == "-c" && stream) {
+			huffman::stream_encoder::encode(input_filename, output_filename, options);
+		}
+		else if (type_flag == "-c") {
+			options.threads = threads;
+			huffman::block_encoder::encode(input_filename, output_filename, options);
+		}
+		else if (type_flag == "-u" && stream) {
+			huffman::stream_decoder::decode(input_filename, output_filename);
+		}
+		else if (type_flag == "-u" && has_range) {
+			huffman::huffman_decoder::decode_range(input_filename, output_filename, range_begin, range_end);
 		}
 		else if (type_flag == "-u") {
-			huffman::huffman_decoder::decode(input_filename, output_filename);
+			huffman::huffman_decoder::decode(input_filename, output_filename, threads);
 		}
 	}
 	catch(...) {
 		exit(1);
 	}
 
+	// Measured on the uncompressed side, to stderr so that the statistics stay as they are.
+	if (throughput && (type_flag == "-c" || type_flag == "-u")) {
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		std::ifstream raw(type_flag == "-c" ? input_filename : output_filename, std::ios::binary | std::ios::ate);
+		if (raw.is_open() && raw.tellg() > 0)
+			std::cerr << raw.tellg() / seconds / 1e6 << " MB/s" << std::endl;
+	}
 	return 0;
 }
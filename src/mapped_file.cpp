@@ -0,0 +1,125 @@
+#include "mapped_file.h"
+#include <fcntl.h>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace huffman;
+
+// The output is sized once from the header and decoded straight into a shared
+// mapping. Outputs that cannot be mapped (pipes, character devices) fall back
+// to an in-memory buffer that is written out on close.
+mapped_output::mapped_output(const std::string& filename, std::size_t size) : filename(filename), length(size) {
+    descriptor = ::open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (descriptor < 0)
+        throw std::invalid_argument("no file");
+    struct stat info;
+    regular = ::fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode);
+    if (length == 0)
+        return;
+
+    if (regular && (::fallocate(descriptor, 0, 0, length) == 0 || ::ftruncate(descriptor, length) == 0)) {
+        void* address = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+        if (address != MAP_FAILED) {
+            memory = static_cast<char*>(address);
+#ifdef MADV_HUGEPAGE
+            ::madvise(memory, length, MADV_HUGEPAGE);
+#endif
+            return;
+        }
+    }
+    fallback.assign(length, '\0');
+    memory = &fallback[0];
+}
+
+// An output that was never closed belongs to a failed decode: a regular file
+// is removed instead of being left at full size with partial contents.
+mapped_output::~mapped_output() {
+    if (descriptor < 0)
+        return;
+    if (is_mapped())
+        ::munmap(memory, length);
+    ::close(descriptor);
+    if (regular)
+        ::unlink(filename.c_str());
+}
+
+char* mapped_output::data() {
+    return memory;
+}
+
+std::size_t mapped_output::size() const {
+    return length;
+}
+
+bool mapped_output::is_mapped() const {
+    return memory && fallback.empty();
+}
+
+void mapped_output::close() {
+    if (descriptor < 0)
+        return;
+    bool failed = false;
+    if (is_mapped()) {
+        failed = ::munmap(memory, length) != 0;
+    }
+    else {
+        for (std::size_t written = 0; written < fallback.size();) {
+            ssize_t count = ::write(descriptor, fallback.data() + written, fallback.size() - written);
+            if (count <= 0) {
+                failed = true;
+                break;
+            }
+            written += count;
+        }
+        fallback.clear();
+    }
+    memory = nullptr;
+    ::close(descriptor);
+    descriptor = -1;
+    if (failed)
+        throw std::runtime_error("cannot write output file");
+}
+
+// Inputs that cannot be mapped are read into memory instead.
+mapped_input::mapped_input(const std::string& filename) {
+    int descriptor = ::open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        throw std::invalid_argument("no file");
+    struct stat info;
+    if (::fstat(descriptor, &info) == 0 && S_ISREG(info.st_mode)) {
+        length = info.st_size;
+        if (length == 0) {
+            ::close(descriptor);
+            return;
+        }
+        void* address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (address != MAP_FAILED) {
+            ::close(descriptor);
+            memory = static_cast<const char*>(address);
+            mapped = true;
+            return;
+        }
+    }
+    ::close(descriptor);
+    std::ifstream file(filename, std::ios::binary);
+    fallback.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    memory = fallback.data();
+    length = fallback.size();
+}
+
+mapped_input::~mapped_input() {
+    if (mapped)
+        ::munmap(const_cast<char*>(memory), length);
+}
+
+const char* mapped_input::data() const {
+    return memory;
+}
+
+std::size_t mapped_input::size() const {
+    return length;
+}
@@ -0,0 +1,93 @@
+#include "parallel_decoder.h"
+#include "parallel_for.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace huffman;
+
+// Decodes the chunk speculatively from its first bit, only counting symbols
+// and remembering the codeword boundaries near the start.
+void parallel_decoder::count_chunk(const std::string& payload, const decode_table& table, chunk& part) {
+    std::size_t total_bits = payload.size() * BYTE_SIZE;
+    bit_reader<> reader(payload, part.begin_bit);
+    char symbol;
+    part.entry_bit = part.begin_bit;
+    while (reader.position() < part.end_bit) {
+        std::size_t position = reader.position();
+        if (position < part.begin_bit + SYNC_WINDOW_BITS)
+            part.boundaries.push_back(position);
+        if (!table.decode(reader, symbol) || reader.position() > total_bits) {
+            part.exit_bit = position;
+            return;
+        }
+        ++part.count;
+    }
+    part.exit_bit = reader.position();
+}
+
+// Decode from the true entry point until we land on one of the speculative
+// codeword boundaries; from there on both decodings agree and the rest of the
+// speculative count holds.
+void parallel_decoder::synchronize(const std::string& payload, const decode_table& table, chunk& part, std::size_t entry_bit) {
+    std::size_t total_bits = payload.size() * BYTE_SIZE, index = 0, prefix = 0;
+    bit_reader<> reader(payload, entry_bit);
+    char symbol;
+    part.entry_bit = entry_bit;
+    while (reader.position() < part.end_bit) {
+        std::size_t position = reader.position();
+        while (index < part.boundaries.size() && part.boundaries[index] < position)
+            ++index;
+        if (index < part.boundaries.size() && part.boundaries[index] == position) {
+            part.count = prefix + part.count - index;
+            return;
+        }
+        if (!table.decode(reader, symbol) || reader.position() > total_bits) {
+            part.count = prefix;
+            part.exit_bit = position;
+            return;
+        }
+        ++prefix;
+    }
+    part.count = prefix;
+    part.exit_bit = reader.position();
+}
+
+void parallel_decoder::decode_chunk(const std::string& payload, const decode_table& table, const chunk& part, char* output, std::size_t count) {
+    bit_reader<> reader(payload, part.entry_bit);
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!table.decode(reader, output[i]))
+            throw std::invalid_argument("file is corrupted");
+    }
+}
+
+// Chunks are counted in parallel, their true entry points are then resolved
+// in order, and every chunk is decoded straight into its own region of the
+// output.
+std::size_t parallel_decoder::decode(const std::string& payload, const decode_table& table, char* output, std::size_t size_of_file, std::size_t threads) {
+    std::size_t total_bits = payload.size() * BYTE_SIZE;
+    std::size_t count = std::max<std::size_t>(1, std::min(threads, total_bits / MIN_CHUNK_BITS));
+    std::vector<chunk> parts(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        parts[i].begin_bit = payload.size() * i / count * BYTE_SIZE;
+        parts[i].end_bit = payload.size() * (i + 1) / count * BYTE_SIZE;
+    }
+
+    parallel_for(count, threads, [&](std::size_t i) {
+        count_chunk(payload, table, parts[i]);
+    });
+    for (std::size_t i = 1; i < count; ++i) {
+        if (parts[i].begin_bit != parts[i - 1].exit_bit)
+            synchronize(payload, table, parts[i], parts[i - 1].exit_bit);
+    }
+
+    std::vector<std::size_t> offsets(count + 1, 0);
+    for (std::size_t i = 0; i < count; ++i)
+        offsets[i + 1] = std::min(size_of_file, offsets[i] + parts[i].count);
+    if (offsets[count] != size_of_file)
+        throw std::invalid_argument("file is corrupted");
+
+    parallel_for(count, threads, [&](std::size_t i) {
+        decode_chunk(payload, table, parts[i], output + offsets[i], offsets[i + 1] - offsets[i]);
+    });
+    return payload.size();
+}
@@ -0,0 +1,34 @@
+#include "parallel_for.h"
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+void huffman::parallel_for(std::size_t count, std::size_t threads, const std::function<void(std::size_t)>& job) {
+    std::atomic<std::size_t> next(0);
+    std::exception_ptr error;
+    std::mutex error_mutex;
+    auto worker = [&]() {
+        for (std::size_t i = next++; i < count; i = next++) {
+            try {
+                job(i);
+            }
+            catch (...) {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!error)
+                    error = std::current_exception();
+                next = count;
+            }
+        }
+    };
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < std::min(threads, count); ++i)
+        workers.emplace_back(worker);
+    worker();
+    for (std::thread& thread : workers)
+        thread.join();
+    if (error)
+        std::rethrow_exception(error);
+}
@@ -0,0 +1,179 @@
+#include "range_coder.h"
+#include "canonical_code.h"
+#include <algorithm>
+#include <stdexcept>
+
+using namespace huffman;
+
+void range_encoder::encode(std::uint16_t& probability, unsigned bit) {
+    encode_fixed(probability, bit);
+    if (bit)
+        probability -= probability >> ADAPTATION_SHIFT;
+    else
+        probability += (PROBABILITY_ONE - probability) >> ADAPTATION_SHIFT;
+}
+
+void range_encoder::encode_fixed(std::uint16_t probability, unsigned bit) {
+    std::uint32_t bound = (range >> PROBABILITY_BITS) * probability;
+    if (bit) {
+        low += bound;
+        range -= bound;
+    }
+    else {
+        range = bound;
+    }
+    while (range < RANGE_TOP) {
+        range <<= 8;
+        shift_low();
+    }
+}
+
+// A byte is held back in cache while a carry out of low may still change it.
+void range_encoder::shift_low() {
+    if ((std::uint32_t)low < 0xff000000u || (low >> 32)) {
+        unsigned char carry = low >> 32;
+        unsigned char pending = cache;
+        do {
+            output += (char)(pending + carry);
+            pending = 0xff;
+        } while (--cache_size);
+        cache = (low >> 24) & 0xff;
+    }
+    ++cache_size;
+    low = (low & 0x00ffffff) << 8;
+}
+
+std::string& range_encoder::finish() {
+    for (std::size_t i = 0; i < 5; ++i)
+        shift_low();
+    return output;
+}
+
+range_decoder::range_decoder(const char* data, std::size_t size) : data((const unsigned char*)data), size(size) {
+    for (std::size_t i = 0; i < 5; ++i)
+        code = code << 8 | next();
+}
+
+unsigned char range_decoder::next() {
+    return current < size ? data[current++] : (++current, 0);
+}
+
+unsigned range_decoder::decode(std::uint16_t& probability) {
+    unsigned bit = decode_fixed(probability);
+    if (bit)
+        probability -= probability >> ADAPTATION_SHIFT;
+    else
+        probability += (PROBABILITY_ONE - probability) >> ADAPTATION_SHIFT;
+    return bit;
+}
+
+unsigned range_decoder::decode_fixed(std::uint16_t probability) {
+    std::uint32_t bound = (range >> PROBABILITY_BITS) * probability;
+    unsigned bit = code >= bound;
+    if (bit) {
+        code -= bound;
+        range -= bound;
+    }
+    else {
+        range = bound;
+    }
+    while (range < RANGE_TOP) {
+        range <<= 8;
+        code = code << 8 | next();
+    }
+    return bit;
+}
+
+std::size_t range_decoder::position() const {
+    return current;
+}
+
+std::string range_coder::encode(const std::string& text, std::size_t& size_of_table) {
+    std::string best;
+    for (unsigned char model : {RANGE_STATIC, RANGE_ORDER0, RANGE_ORDER1}) {
+        std::size_t size_of_model_table = 0;
+        std::string body = encode(text, model, size_of_model_table);
+        if (best.empty() || body.size() < best.size()) {
+            best.swap(body);
+            size_of_table = size_of_model_table;
+        }
+    }
+    return best;
+}
+
+// Static probabilities are those of the tree nodes over the whole block,
+// clamped so that no bit costs more than 6 bits, and sent as 2 bytes each.
+std::string range_coder::encode(const std::string& text, unsigned char model, std::size_t& size_of_table) {
+    std::string body(1, (char)model);
+    std::vector<std::uint16_t> probabilities((model == RANGE_ORDER1 ? ALPHABET_SIZE : 1) * ALPHABET_SIZE, PROBABILITY_ONE / 2);
+    if (model == RANGE_STATIC) {
+        std::vector<std::uint64_t> zeros(ALPHABET_SIZE, 0), totals(ALPHABET_SIZE, 0);
+        for (char symbol : text) {
+            for (std::size_t node = 1, bit = 8; bit-- > 0;) {
+                unsigned value = ((unsigned char)symbol >> bit) & 1;
+                ++totals[node];
+                zeros[node] += !value;
+                node = node * 2 + value;
+            }
+        }
+        for (std::size_t node = 1; node < ALPHABET_SIZE; ++node) {
+            std::uint64_t probability = totals[node] ? (zeros[node] * PROBABILITY_ONE + totals[node] / 2) / totals[node] : PROBABILITY_ONE / 2;
+            probability = std::min<std::uint64_t>(std::max<std::uint64_t>(probability, PROBABILITY_ONE >> 6), PROBABILITY_ONE - (PROBABILITY_ONE >> 6));
+            probabilities[node] = probability;
+            body += (char)(probability & 0xff);
+            body += (char)(probability >> 8);
+        }
+    }
+    size_of_table = body.size();
+
+    range_encoder encoder;
+    unsigned char previous = 0;
+    for (char symbol : text) {
+        std::uint16_t* tree = &probabilities[model == RANGE_ORDER1 ? previous * ALPHABET_SIZE : 0];
+        for (std::size_t node = 1, bit = 8; bit-- > 0;) {
+            unsigned value = ((unsigned char)symbol >> bit) & 1;
+            if (model == RANGE_STATIC)
+                encoder.encode_fixed(tree[node], value);
+            else
+                encoder.encode(tree[node], value);
+            node = node * 2 + value;
+        }
+        previous = symbol;
+    }
+    return body + encoder.finish();
+}
+
+std::size_t range_coder::decode(const char* body, std::size_t size, char* output, std::size_t size_of_output) {
+    if (!size || (unsigned char)body[0] > RANGE_ORDER1)
+        throw std::invalid_argument("file is corrupted");
+    unsigned char model = body[0];
+    std::size_t position = 1;
+    std::vector<std::uint16_t> probabilities((model == RANGE_ORDER1 ? ALPHABET_SIZE : 1) * ALPHABET_SIZE, PROBABILITY_ONE / 2);
+    if (model == RANGE_STATIC) {
+        if (size < position + 2 * (ALPHABET_SIZE - 1))
+            throw std::invalid_argument("file is corrupted");
+        for (std::size_t node = 1; node < ALPHABET_SIZE; ++node, position += 2) {
+            probabilities[node] = (unsigned char)body[position] | (unsigned char)body[position + 1] << 8;
+            if (!probabilities[node] || probabilities[node] >= PROBABILITY_ONE)
+                throw std::invalid_argument("file is corrupted");
+        }
+    }
+
+    range_decoder decoder(body + position, size - position);
+    unsigned char previous = 0;
+    for (std::size_t i = 0; i < size_of_output; ++i) {
+        std::uint16_t* tree = &probabilities[model == RANGE_ORDER1 ? previous * ALPHABET_SIZE : 0];
+        std::size_t node = 1;
+        while (node < ALPHABET_SIZE) {
+            if (model == RANGE_STATIC)
+                node = node * 2 + decoder.decode_fixed(tree[node]);
+            else
+                node = node * 2 + decoder.decode(tree[node]);
+        }
+        previous = node - ALPHABET_SIZE;
+        output[i] = previous;
+    }
+    if (decoder.position() > size - position)
+        throw std::invalid_argument("file is corrupted");
+    return position;
+}
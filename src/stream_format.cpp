@@ -0,0 +1,244 @@
+#include "stream_format.h"
+#include "adaptive_huffman.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <poll.h>
+#include <stdexcept>
+#include <unistd.h>
+
+using namespace huffman;
+
+file_descriptor::file_descriptor(const std::string& filename, bool output, bool append) : owned(filename != STANDARD_STREAM) {
+    if (!owned)
+        descriptor = output ? STDOUT_FILENO : STDIN_FILENO;
+    else
+        descriptor = output ? ::open(filename.c_str(), O_WRONLY | O_CREAT | (append ? O_APPEND : O_TRUNC), 0644) : ::open(filename.c_str(), O_RDONLY);
+    if (descriptor < 0)
+        throw std::invalid_argument("no file");
+}
+
+file_descriptor::~file_descriptor() {
+    if (owned)
+        ::close(descriptor);
+}
+
+int file_descriptor::get() const {
+    return descriptor;
+}
+
+bool file_descriptor::read_exact(char* data, std::size_t size) {
+    std::size_t done = 0;
+    while (done < size) {
+        ssize_t count = ::read(descriptor, data + done, size - done);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            throw std::runtime_error("cannot read input");
+        if (count == 0)
+            break;
+        done += count;
+    }
+    if (done && done < size)
+        throw std::invalid_argument("file is corrupted");
+    return done == size;
+}
+
+void file_descriptor::write_all(const char* data, std::size_t size) {
+    while (size) {
+        ssize_t count = ::write(descriptor, data, size);
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0)
+            throw std::runtime_error("cannot write output file");
+        data += count;
+        size -= count;
+    }
+}
+
+void stream_encoder::encode(const std::string& input_filename, const std::string& output_filename, const encoder_options& options) {
+    if (!options.block_size || options.block_size > MAX_BLOCK_SIZE)
+        throw std::invalid_argument("invalid block size");
+    if (options.shard_count != 1)
+        throw std::invalid_argument("invalid shard");
+    if (options.append && output_filename != STANDARD_STREAM)
+        block_encoder::get_append_offset(output_filename);
+    if (options.coder == CODER_ADAPTIVE) {
+        encode_adaptive(input_filename, output_filename, options);
+        return;
+    }
+    file_descriptor input(input_filename, false);
+    file_descriptor output(output_filename, true, options.append);
+    file_header header;
+    header.flags = FLAG_STREAM;
+    header.block_size = options.block_size;
+    std::string frame;
+    block_encoder::write_file_header(frame, header);
+    output.write_all(frame.data(), frame.size());
+
+    std::size_t size_of_payload = 0, additional_information = FILE_HEADER_SIZE + BLOCK_HEADER_SIZE;
+    std::string buffer, chunk(READ_CHUNK_SIZE, '\0');
+    std::vector<unsigned char> previous;
+    auto flush = [&]() {
+        block_header block;
+        std::size_t size_of_table;
+        std::string body = block_encoder::encode_block(buffer.data(), buffer.size(), options, block, size_of_table, previous);
+        frame.clear();
+        block_encoder::write_block_header(frame, block);
+        frame += body;
+        output.write_all(frame.data(), frame.size());
+        size_of_payload += body.size() - size_of_table;
+        additional_information += BLOCK_HEADER_SIZE + size_of_table;
+        header.size_of_file += buffer.size();
+        buffer.clear();
+    };
+    while (true) {
+        pollfd request = {input.get(), POLLIN, 0};
+        int ready = ::poll(&request, 1, buffer.empty() ? -1 : (int)options.flush_interval);
+        if (ready < 0 && errno != EINTR)
+            throw std::runtime_error("cannot read input");
+        if (ready == 0) {
+            flush();
+            continue;
+        }
+        if (ready < 0)
+            continue;
+        ssize_t count = ::read(input.get(), &chunk[0], std::min(chunk.size(), options.block_size - buffer.size()));
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            throw std::runtime_error("cannot read input");
+        if (count == 0)
+            break;
+        buffer.append(chunk.data(), count);
+        if (buffer.size() == options.block_size)
+            flush();
+    }
+    if (!buffer.empty())
+        flush();
+
+    block_header end;
+    end.coder = CODER_END;
+    frame.clear();
+    block_encoder::write_block_header(frame, end);
+    output.write_all(frame.data(), frame.size());
+    (output_filename == STANDARD_STREAM ? std::cerr : std::cout) << header.size_of_file << std::endl << size_of_payload << std::endl << additional_information << std::endl;
+}
+
+// Every read goes out as its own frame, so a byte written to the input is on
+// the output as soon as it is coded. Only the last byte of a frame is padded.
+void stream_encoder::encode_adaptive(const std::string& input_filename, const std::string& output_filename, const encoder_options& options) {
+    file_descriptor input(input_filename, false);
+    file_descriptor output(output_filename, true, options.append);
+    file_header header;
+    header.flags = FLAG_STREAM | FLAG_ADAPTIVE;
+    std::string frame;
+    block_encoder::write_file_header(frame, header);
+    output.write_all(frame.data(), frame.size());
+
+    adaptive_huffman model;
+    std::size_t size_of_payload = 0, additional_information = FILE_HEADER_SIZE;
+    std::string chunk(READ_CHUNK_SIZE, '\0');
+    while (true) {
+        ssize_t count = ::read(input.get(), &chunk[0], chunk.size());
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count < 0)
+            throw std::runtime_error("cannot read input");
+        bit_writer writer;
+        for (ssize_t i = 0; i < count; ++i)
+            model.encode(chunk[i], writer);
+        const std::string& body = writer.finish();
+        std::uint32_t size = count, packed_size = body.size();
+        frame.assign((const char*)&size, sizeof(size));
+        frame.append((const char*)&packed_size, sizeof(packed_size));
+        frame += body;
+        output.write_all(frame.data(), frame.size());
+        header.size_of_file += count;
+        size_of_payload += body.size();
+        additional_information += ADAPTIVE_FRAME_SIZE;
+        if (count == 0)
+            break;
+    }
+    (output_filename == STANDARD_STREAM ? std::cerr : std::cout) << header.size_of_file << std::endl << size_of_payload << std::endl << additional_information << std::endl;
+}
+
+// Frames of one member share the model, every frame is written out as soon as
+// it is decoded. Returns the size of the member.
+std::size_t stream_decoder::decode_adaptive(file_descriptor& input, file_descriptor& output, std::size_t& size_of_payload, std::size_t& additional_information) {
+    adaptive_huffman model;
+    std::size_t size_of_member = 0;
+    std::string frame(ADAPTIVE_FRAME_SIZE, '\0'), body, text;
+    while (true) {
+        if (!input.read_exact(&frame[0], frame.size()))
+            throw std::invalid_argument("file is corrupted");
+        additional_information += ADAPTIVE_FRAME_SIZE;
+        // The body is not buffered yet, bound it by the largest block instead.
+        block_header header = block_decoder::read_frame_header(frame.data(), ADAPTIVE_FRAME_SIZE + 2 * MAX_BLOCK_SIZE);
+        if (header.coder == CODER_END)
+            return size_of_member;
+        body.resize(header.packed_size);
+        if (!input.read_exact(&body[0], body.size()))
+            throw std::invalid_argument("file is corrupted");
+        text.resize(header.raw_size);
+        bit_reader<> reader(body);
+        for (char& symbol : text)
+            model.decode(reader, symbol);
+        if (reader.position() > body.size() * BYTE_SIZE)
+            throw std::invalid_argument("file is corrupted");
+        output.write_all(text.data(), text.size());
+        size_of_member += text.size();
+        size_of_payload += body.size();
+    }
+}
+
+// Reads block files of both kinds front to back, member after member, and
+// writes every block out as soon as it has been decoded, so it works on pipes.
+void stream_decoder::decode(const std::string& input_filename, const std::string& output_filename) {
+    file_descriptor input(input_filename, false);
+    file_descriptor output(output_filename, true);
+    std::size_t size_of_file = 0, size_of_payload = 0, additional_information = 0;
+    std::string frame, body, text;
+    for (bool first = true; ; first = false) {
+        frame.resize(FILE_HEADER_SIZE);
+        if (!input.read_exact(&frame[0], frame.size())) {
+            if (first)
+                throw std::invalid_argument("file is corrupted");
+            break;
+        }
+        file_header header = block_decoder::read_file_header(frame.data(), frame.size());
+        additional_information += FILE_HEADER_SIZE;
+        if (header.flags & FLAG_ADAPTIVE) {
+            size_of_file += decode_adaptive(input, output, size_of_payload, additional_information);
+            continue;
+        }
+        bool stream = header.flags & FLAG_STREAM;
+        std::size_t size_of_member = 0;
+        std::shared_ptr<const huffman_table> table;
+        for (std::uint64_t i = 0; stream || i < header.block_count; ++i) {
+            frame.resize(BLOCK_HEADER_SIZE);
+            if (!input.read_exact(&frame[0], frame.size()))
+                throw std::invalid_argument("file is corrupted");
+            additional_information += BLOCK_HEADER_SIZE;
+            // The body is not buffered yet, bound it by the largest block instead.
+            block_header block = block_decoder::read_block_header(frame.data(), BLOCK_HEADER_SIZE + 2 * MAX_BLOCK_SIZE);
+            if (stream && block.coder == CODER_END)
+                break;
+            body.resize(block.packed_size);
+            if (block.raw_size > MAX_BLOCK_SIZE || !input.read_exact(&body[0], body.size()))
+                throw std::invalid_argument("file is corrupted");
+            text.resize(block.raw_size);
+            std::size_t size_of_table = block_decoder::decode_block(block, body.data(), &text[0], table);
+            output.write_all(text.data(), text.size());
+            size_of_member += text.size();
+            size_of_payload += block.packed_size - size_of_table;
+            additional_information += size_of_table;
+        }
+        if (!stream && size_of_member != header.size_of_file)
+            throw std::invalid_argument("file is corrupted");
+        size_of_file += size_of_member;
+    }
+    (output_filename == STANDARD_STREAM ? std::cerr : std::cout) << size_of_payload << std::endl << size_of_file << std::endl << additional_information << std::endl;
+}
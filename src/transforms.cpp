@@ -0,0 +1,318 @@
+#include "transforms.h"
+#include "block_splitter.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+using namespace huffman;
+
+std::string run_length::encode(const std::string& text) {
+    std::string runs;
+    runs.reserve(text.size());
+    for (std::size_t i = 0; i < text.size();) {
+        std::size_t j = i;
+        while (j < text.size() && text[j] == text[i] && j - i < RUN_THRESHOLD + MAX_RUN_EXTENSION)
+            ++j;
+        if (j - i >= RUN_THRESHOLD) {
+            runs.append(RUN_THRESHOLD, text[i]);
+            runs += (char)(j - i - RUN_THRESHOLD);
+        }
+        else {
+            runs.append(j - i, text[i]);
+        }
+        i = j;
+    }
+    return runs;
+}
+
+void run_length::decode(const std::string& runs, char* output, std::size_t size_of_output) {
+    std::size_t written = 0, run = 0;
+    char last = 0;
+    for (std::size_t i = 0; i < runs.size(); ++i) {
+        if (run == RUN_THRESHOLD) {
+            std::size_t extension = (unsigned char)runs[i];
+            if (extension > size_of_output - written)
+                throw std::invalid_argument("file is corrupted");
+            std::memset(output + written, last, extension);
+            written += extension;
+            run = 0;
+            continue;
+        }
+        if (written == size_of_output)
+            throw std::invalid_argument("file is corrupted");
+        output[written++] = runs[i];
+        run = (run && runs[i] == last) ? run + 1 : 1;
+        last = runs[i];
+    }
+    if (written != size_of_output)
+        throw std::invalid_argument("file is corrupted");
+}
+
+void burrows_wheeler::get_buckets(const std::int32_t* text, std::size_t size, std::size_t alphabet, std::vector<std::int32_t>& buckets, bool ends) {
+    buckets.assign(alphabet, 0);
+    for (std::size_t i = 0; i < size; ++i)
+        ++buckets[text[i]];
+    std::int32_t sum = 0;
+    for (std::int32_t& bucket : buckets) {
+        sum += bucket;
+        bucket = ends ? sum : sum - bucket;
+    }
+}
+
+// Places L-type suffixes from the sorted seeds left to right, then S-type
+// suffixes right to left.
+void burrows_wheeler::induce(const std::int32_t* text, std::int32_t* suffixes, std::size_t size, std::size_t alphabet, const std::vector<unsigned char>& small) {
+    std::vector<std::int32_t> buckets;
+    get_buckets(text, size, alphabet, buckets, false);
+    for (std::size_t i = 0; i < size; ++i) {
+        std::int32_t j = suffixes[i] - 1;
+        if (suffixes[i] > 0 && !small[j])
+            suffixes[buckets[text[j]]++] = j;
+    }
+    get_buckets(text, size, alphabet, buckets, true);
+    for (std::size_t i = size; i-- > 0;) {
+        std::int32_t j = suffixes[i] - 1;
+        if (suffixes[i] > 0 && small[j])
+            suffixes[--buckets[text[j]]] = j;
+    }
+}
+
+// SA-IS: sorts the LMS substrings by induction, names them, recurses on the
+// names if two are equal and induces the full order from the sorted LMS
+// suffixes. text must end with a unique smallest symbol.
+void burrows_wheeler::sort_suffixes(const std::int32_t* text, std::int32_t* suffixes, std::size_t size, std::size_t alphabet) {
+    std::vector<unsigned char> small(size, 1);
+    for (std::size_t i = size - 1; i-- > 0;)
+        small[i] = text[i] < text[i + 1] || (text[i] == text[i + 1] && small[i + 1]);
+    auto is_leftmost = [&](std::size_t i) { return i > 0 && small[i] && !small[i - 1]; };
+
+    std::vector<std::int32_t> buckets;
+    get_buckets(text, size, alphabet, buckets, true);
+    std::fill(suffixes, suffixes + size, -1);
+    for (std::size_t i = 1; i < size; ++i) {
+        if (is_leftmost(i))
+            suffixes[--buckets[text[i]]] = i;
+    }
+    induce(text, suffixes, size, alphabet, small);
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        if (is_leftmost(suffixes[i]))
+            suffixes[count++] = suffixes[i];
+    }
+    std::fill(suffixes + count, suffixes + size, -1);
+    std::int32_t names = 0, previous = -1;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::int32_t position = suffixes[i];
+        bool different = false;
+        for (std::size_t d = 0; ; ++d) {
+            if (previous < 0 || text[position + d] != text[previous + d] || small[position + d] != small[previous + d]) {
+                different = true;
+                break;
+            }
+            if (d > 0 && (is_leftmost(position + d) || is_leftmost(previous + d)))
+                break;
+        }
+        if (different) {
+            ++names;
+            previous = position;
+        }
+        suffixes[count + position / 2] = names - 1;
+    }
+    for (std::size_t i = size, j = size; i-- > count;) {
+        if (suffixes[i] >= 0)
+            suffixes[--j] = suffixes[i];
+    }
+
+    std::int32_t* reduced = suffixes + size - count;
+    if ((std::size_t)names < count)
+        sort_suffixes(reduced, suffixes, count, names);
+    else {
+        for (std::size_t i = 0; i < count; ++i)
+            suffixes[reduced[i]] = i;
+    }
+    for (std::size_t i = 1, j = 0; i < size; ++i) {
+        if (is_leftmost(i))
+            reduced[j++] = i;
+    }
+    for (std::size_t i = 0; i < count; ++i)
+        suffixes[i] = reduced[suffixes[i]];
+    std::fill(suffixes + count, suffixes + size, -1);
+    get_buckets(text, size, alphabet, buckets, true);
+    for (std::size_t i = count; i-- > 0;) {
+        std::int32_t j = suffixes[i];
+        suffixes[i] = -1;
+        suffixes[--buckets[text[j]]] = j;
+    }
+    induce(text, suffixes, size, alphabet, small);
+}
+
+std::vector<std::uint32_t> burrows_wheeler::get_suffix_array(const std::string& text) {
+    std::vector<std::int32_t> symbols(text.size() + 1, 0), suffixes(text.size() + 1);
+    for (std::size_t i = 0; i < text.size(); ++i)
+        symbols[i] = (unsigned char)text[i] + 1;
+    sort_suffixes(symbols.data(), suffixes.data(), symbols.size(), 257);
+    return std::vector<std::uint32_t>(suffixes.begin() + 1, suffixes.end());
+}
+
+std::string burrows_wheeler::encode(const std::string& text) {
+    if (text.size() > MAX_SORTED_SIZE)
+        throw std::invalid_argument("invalid block size");
+    std::vector<std::uint32_t> suffixes = get_suffix_array(text);
+    std::string sorted(BWT_INDEX_SIZE + text.size(), '\0');
+    // Row 0 is the end symbol alone, preceded by the last byte.
+    std::size_t position = BWT_INDEX_SIZE;
+    std::uint32_t primary = 0;
+    if (!text.empty())
+        sorted[position++] = text.back();
+    for (std::size_t i = 0; i < suffixes.size(); ++i) {
+        if (suffixes[i] == 0)
+            primary = i + 1;
+        else
+            sorted[position++] = text[suffixes[i] - 1];
+    }
+    std::memcpy(&sorted[0], &primary, BWT_INDEX_SIZE);
+    return sorted;
+}
+
+void burrows_wheeler::decode(const std::string& sorted, char* output, std::size_t size_of_output) {
+    std::uint32_t primary = 0;
+    if (sorted.size() != BWT_INDEX_SIZE + size_of_output)
+        throw std::invalid_argument("file is corrupted");
+    std::memcpy(&primary, sorted.data(), BWT_INDEX_SIZE);
+    if (!size_of_output)
+        return;
+    if (primary == 0 || primary > size_of_output || size_of_output > MAX_SORTED_SIZE)
+        throw std::invalid_argument("file is corrupted");
+    const unsigned char* last = (const unsigned char*)sorted.data() + BWT_INDEX_SIZE;
+
+    // Row i of the last column maps to the row starting with the same
+    // occurrence of its byte; the end symbol sorts first. The byte is kept in
+    // the low bits of the row it leads to, so each step is one random access.
+    std::vector<std::uint32_t> counts(256, 0);
+    std::vector<std::uint32_t> rows(size_of_output + 1, 0);
+    for (std::size_t i = 0; i < size_of_output; ++i)
+        ++counts[last[i]];
+    std::uint32_t total = 1;
+    for (std::uint32_t& count : counts) {
+        std::uint32_t value = count;
+        count = total;
+        total += value;
+    }
+    for (std::size_t row = 0, i = 0; row <= size_of_output; ++row) {
+        if (row != primary) {
+            rows[row] = counts[last[i]]++ << 8 | last[i];
+            ++i;
+        }
+    }
+    std::uint32_t row = rows[0];
+    for (std::size_t k = size_of_output; k-- > 0;) {
+        output[k] = row;
+        row >>= 8;
+        if (row == primary && k)
+            throw std::invalid_argument("file is corrupted");
+        row = rows[row];
+    }
+}
+
+void move_to_front::encode(std::string& text) {
+    unsigned char order[256];
+    for (std::size_t i = 0; i < 256; ++i)
+        order[i] = i;
+    for (char& symbol : text) {
+        unsigned char value = symbol, index = 0;
+        while (order[index] != value)
+            ++index;
+        std::memmove(order + 1, order, index);
+        order[0] = value;
+        symbol = index;
+    }
+}
+
+void move_to_front::decode(std::string& text) {
+    unsigned char order[256];
+    for (std::size_t i = 0; i < 256; ++i)
+        order[i] = i;
+    for (char& symbol : text) {
+        unsigned char index = symbol, value = order[index];
+        std::memmove(order + 1, order, index);
+        order[0] = value;
+        symbol = value;
+    }
+}
+
+// Every filter is tried on a sample from the middle of the data and ranked by
+// the order-0 entropy of its output; 0 means that none beats the data as is.
+unsigned char delta_filter::choose(const char* data, std::size_t size) {
+    std::size_t length = std::min(size, FILTER_SAMPLE_SIZE);
+    std::string sample(data + (size - length) / 2, length);
+    histogram counts;
+    block_splitter::count(sample.data(), sample.size(), counts);
+    double best = block_splitter::get_cost(counts) * 0.95;
+    unsigned char chosen = 0;
+    std::vector<unsigned char> filters = {FILTER_DELTA | 1, FILTER_DELTA | 2, FILTER_DELTA | 3, FILTER_DELTA | 4, FILTER_DELTA | 8};
+    for (unsigned char stride : {2, 4, 8}) {
+        filters.push_back(FILTER_PLANES | stride);
+        filters.push_back(FILTER_PLANES | FILTER_DELTA | stride);
+    }
+    for (unsigned char filter : filters) {
+        std::string filtered = encode(sample, filter);
+        block_splitter::count(filtered.data() + 1, filtered.size() - 1, counts);
+        double cost = block_splitter::get_cost(counts);
+        if (cost < best) {
+            best = cost;
+            chosen = filter;
+        }
+    }
+    return chosen;
+}
+
+std::string delta_filter::encode(const std::string& text, unsigned char filter) {
+    std::size_t stride = filter & (FILTER_PLANES - 1), size = text.size();
+    std::string filtered(1 + size, (char)filter);
+    char* output = &filtered[1];
+    if (filter & FILTER_PLANES) {
+        std::size_t position = 0;
+        for (std::size_t plane = 0; plane < stride; ++plane) {
+            for (std::size_t i = plane; i < size; i += stride)
+                output[position++] = text[i];
+        }
+        stride = 1;
+    }
+    else {
+        std::memcpy(output, text.data(), size);
+    }
+    if (filter & FILTER_DELTA) {
+        for (std::size_t i = size; i-- > stride;)
+            output[i] = output[i] - output[i - stride];
+    }
+    return filtered;
+}
+
+void delta_filter::decode(const std::string& filtered, char* output, std::size_t size_of_output) {
+    if (filtered.size() != size_of_output + 1)
+        throw std::invalid_argument("file is corrupted");
+    unsigned char filter = filtered[0];
+    std::size_t stride = filter & (FILTER_PLANES - 1);
+    if (!stride || stride > MAX_FILTER_STRIDE || !(filter & (FILTER_PLANES | FILTER_DELTA)))
+        throw std::invalid_argument("file is corrupted");
+    std::string planes;
+    char* target = output;
+    if (filter & FILTER_PLANES) {
+        planes.resize(size_of_output);
+        target = &planes[0];
+    }
+    std::memcpy(target, filtered.data() + 1, size_of_output);
+    if (filter & FILTER_DELTA) {
+        std::size_t distance = filter & FILTER_PLANES ? 1 : stride;
+        for (std::size_t i = distance; i < size_of_output; ++i)
+            target[i] = target[i] + target[i - distance];
+    }
+    if (filter & FILTER_PLANES) {
+        std::size_t position = 0;
+        for (std::size_t plane = 0; plane < stride; ++plane) {
+            for (std::size_t i = plane; i < size_of_output; i += stride)
+                output[i] = planes[position++];
+        }
+    }
+}